@@ -0,0 +1,64 @@
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <tuple>
+#include <strata/db_adapters.hpp>
+
+//Mostly numeric and timestamp columns, where the text format pays for parsing and the binary one doesn't.
+constexpr const char* setup_sql =
+  "create table if not exists strata_bench_wide (id bigint primary key, a integer, b bigint, c double precision, "
+  "d double precision, e double precision, f numeric(12,4), g integer, created_at timestamptz, updated_at timestamptz)";
+constexpr const char* seed_sql =
+  "insert into strata_bench_wide select n, n % 1000, n * 7919, n / 3.0, sqrt(n), n * 0.5, n / 7.0, n % 17, "
+  "now() - n * interval '1 second', now() from generate_series(1, 100000) n on conflict do nothing";
+constexpr const char* select_sql =
+  "select id, a, b, c, d, e, f, g, created_at, updated_at from strata_bench_wide";
+
+//libpqxx has no timestamp conversion, so the text format keeps those two as strings.
+using text_T = std::tuple<long long, int, long long, double, double, double, double, int, std::string, std::string>;
+using binary_T = std::tuple<long long, int, long long, double, double, double, double, int,
+                            db_adapter::binary::timestamp, db_adapter::binary::timestamp>;
+
+//CPU time of the process, so waiting on the server and the network is left out.
+template <typename Fn>
+double cpu_ms(Fn fn, int iterations){
+  std::clock_t start = std::clock();
+  for(int i = 0; i < iterations; ++i) fn();
+  return 1000.0 * static_cast<double>(std::clock() - start) / CLOCKS_PER_SEC / iterations;
+}
+
+int main(){
+  constexpr int iterations = 20;
+  std::size_t rows = 0;
+
+  {
+    db_adapter::Pool::Lease lease = db_adapter::Pool::instance().acquire(db_adapter::PRIMARY);
+    pqxx::work txn(lease.cxn());
+    txn.exec(setup_sql);
+    txn.exec(seed_sql);
+    txn.commit();
+  }
+
+  //Both formats run on the same pooled connection, so connection setup is not part of either measurement.
+  db_adapter::Pool::Lease lease = db_adapter::Pool::instance().acquire(db_adapter::REPLICA);
+
+  double text_ms = cpu_ms([&]{
+    pqxx::nontransaction txn(lease.cxn());
+    std::vector<text_T> values {};
+    for(const pqxx::row& row : txn.exec(select_sql)) values.push_back(row.as_tuple<text_T>());
+    rows = values.size();
+  }, iterations);
+
+  double binary_ms = cpu_ms([&]{
+    rows = lease.with_raw([](PGconn* raw){
+      db_adapter::binary::Result result {PQexecParams(raw, select_sql, 0, nullptr, nullptr, nullptr, nullptr, 1)};
+      if(PQresultStatus(result.get()) != PGRES_TUPLES_OK) throw std::runtime_error(PQerrorMessage(raw));
+      return db_adapter::binary::to_values<binary_T>(result).size();
+    });
+  }, iterations);
+
+  std::cout<< "rows per fetch: " << rows << "\n"
+           << "text format:   " << text_ms << " ms CPU/fetch\n"
+           << "binary format: " << binary_ms << " ms CPU/fetch" << std::endl;
+  return 0;
+}
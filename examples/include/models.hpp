@@ -1,4 +1,6 @@
+#include <array>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <pqxx/row>
 #include <tuple>
@@ -16,6 +18,12 @@ public:
   std::string col_str = "pin,email,username";
   int col_map_size = 3;
 
+  static constexpr std::string_view select_list = "users_id,pin,email,username";
+  static constexpr std::string_view select_sql = "select users_id,pin,email,username from users";
+  static constexpr std::string_view insert_sql = "insert into users (pin,email,username) values($1,$2,$3);";
+  static constexpr std::array<std::string_view, 3> sql_types = {"INTEGER","VARCHAR(50)","VARCHAR(24)",};
+  static constexpr std::array<std::string_view, 2> unique_keys = {"email","username",};
+
   users() = default;
   template <typename tuple_T>
   users(tuple_T tup){
@@ -54,6 +62,12 @@ public:
   std::string col_str = "content,receiver,sender";
   int col_map_size = 3;
 
+  static constexpr std::string_view select_list = "message_id,content,receiver,sender";
+  static constexpr std::string_view select_sql = "select message_id,content,receiver,sender from message";
+  static constexpr std::string_view insert_sql = "insert into message (content,receiver,sender) values($1,$2,$3);";
+  static constexpr std::array<std::string_view, 3> sql_types = {"VARCHAR(256)","INTEGER","INTEGER",};
+  static constexpr std::array<std::string_view, 0> unique_keys = {};
+
   message() = default;
   template <typename tuple_T>
   message(tuple_T tup){
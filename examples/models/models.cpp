@@ -30,7 +30,7 @@ int main(){
 
   model.make_migrations(mrm, frm, sql_filename);
 
-  std::optional<pqxx::result> result = db_adapter::execute_sql(sql_filename);
+  std::size_t applied = db_adapter::run_migrations(sql_filename);
 
   return 0;
 }
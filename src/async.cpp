@@ -0,0 +1,150 @@
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <stdexcept>
+#include "../strata/async.hpp"
+
+namespace psql::async{
+
+Lease::~Lease(){
+  if(cxn) loop->release(cxn);
+}
+
+Loop::~Loop(){
+  for(PGconn* cxn : idle) PQfinish(cxn);
+}
+
+Loop& Loop::current(){
+  thread_local Loop loop {};
+  return loop;
+}
+
+void Loop::spawn(Task<void> task){
+  ready.push_back(task.handle());
+  tasks.push_back(std::move(task));
+}
+
+void Loop::run(){
+  std::exception_ptr first_error {};
+
+  while(true){
+    while(!ready.empty()){
+      std::vector<std::coroutine_handle<>> batch {};
+      batch.swap(ready);
+      for(std::coroutine_handle<> handle : batch) handle.resume();
+    }
+
+    for(auto it = tasks.begin(); it != tasks.end();){
+      if(it->handle().done()){
+        if(it->handle().promise().error && !first_error) first_error = it->handle().promise().error;
+        it = tasks.erase(it);
+        continue;
+      }
+      ++it;
+    }
+
+    if(waiters.empty()) break;
+
+    std::vector<pollfd> fds {};
+    fds.reserve(waiters.size());
+    for(const Waiter& waiter : waiters){
+      fds.push_back(pollfd{waiter.fd, static_cast<short>(waiter.write ? POLLOUT : POLLIN), 0});
+    }
+
+    if(::poll(fds.data(), fds.size(), -1) < 0){
+      if(errno == EINTR) continue;
+      throw std::runtime_error(std::format("[ERROR: in 'async::Loop::run()'] => poll failed: {}", std::strerror(errno)));
+    }
+
+    std::vector<Waiter> pending {};
+    for(std::size_t i = 0; i < fds.size(); ++i){
+      if(fds[i].revents) ready.push_back(waiters[i].handle);
+      else pending.push_back(waiters[i]);
+    }
+    waiters.swap(pending);
+  }
+
+  if(first_error) std::rethrow_exception(first_error);
+}
+
+void Loop::wait_socket(int fd, bool write, std::coroutine_handle<> handle){
+  waiters.push_back(Waiter{fd, write, handle});
+}
+
+Task<Lease> Loop::acquire(){
+  if(!idle.empty()){
+    PGconn* cxn = idle.back();
+    idle.pop_back();
+    co_return Lease{*this, cxn};
+  }
+
+  PGconn* cxn = PQconnectStart(conn_string(Utils::parse_db_conn_params()).c_str());
+  if(!cxn) throw std::runtime_error("[ERROR: in 'async::Loop::acquire()'] => Out of memory allocating a connection.");
+  Lease lease {*this, cxn};
+  //A bad conninfo fails immediately and leaves no socket to poll on.
+  if(PQstatus(cxn) == CONNECTION_BAD)
+    throw std::runtime_error(std::format("[ERROR: in 'async::Loop::acquire()'] => {}", PQerrorMessage(cxn)));
+
+  PostgresPollingStatusType status = PGRES_POLLING_WRITING;
+  while(status != PGRES_POLLING_OK){
+    if(status == PGRES_POLLING_FAILED)
+      throw std::runtime_error(std::format("[ERROR: in 'async::Loop::acquire()'] => {}", PQerrorMessage(cxn)));
+    co_await SocketReady{*this, PQsocket(cxn), status == PGRES_POLLING_WRITING};
+    status = PQconnectPoll(cxn);
+  }
+
+  if(PQsetnonblocking(cxn, 1) != 0)
+    throw std::runtime_error(std::format("[ERROR: in 'async::Loop::acquire()'] => {}", PQerrorMessage(cxn)));
+  co_return lease;
+}
+
+void Loop::release(PGconn* cxn){
+  if(PQstatus(cxn) == CONNECTION_OK && PQtransactionStatus(cxn) == PQTRANS_IDLE) idle.push_back(cxn);
+  else PQfinish(cxn);
+}
+
+Task<binary::Result> exec(std::string sql_string, std::vector<std::string> params){
+  Loop& loop = Loop::current();
+  Lease lease = co_await loop.acquire();
+  PGconn* cxn = lease.get();
+
+  std::vector<const char*> values {};
+  values.reserve(params.size());
+  for(const std::string& param : params) values.push_back(param.c_str());
+
+  if(!PQsendQueryParams(cxn, sql_string.c_str(), static_cast<int>(values.size()), nullptr, values.data(), nullptr, nullptr, 1))
+    throw std::runtime_error(std::format("[ERROR: in 'async::exec()'] => {}", PQerrorMessage(cxn)));
+
+  int flushed = 0;
+  while((flushed = PQflush(cxn)) == 1){
+    co_await SocketReady{loop, PQsocket(cxn), true};
+    if(!PQconsumeInput(cxn)) throw std::runtime_error(std::format("[ERROR: in 'async::exec()'] => {}", PQerrorMessage(cxn)));
+  }
+  if(flushed < 0) throw std::runtime_error(std::format("[ERROR: in 'async::exec()'] => {}", PQerrorMessage(cxn)));
+
+  std::optional<binary::Result> last {};
+  std::string error {};
+  while(true){
+    while(PQisBusy(cxn)){
+      co_await SocketReady{loop, PQsocket(cxn), false};
+      if(!PQconsumeInput(cxn)) throw std::runtime_error(std::format("[ERROR: in 'async::exec()'] => {}", PQerrorMessage(cxn)));
+    }
+
+    PGresult* raw = PQgetResult(cxn);
+    if(!raw) break;
+
+    binary::Result result {raw};
+    ExecStatusType status = PQresultStatus(raw);
+    if(status == PGRES_TUPLES_OK || status == PGRES_COMMAND_OK) last.emplace(std::move(result));
+    else if(error.empty()) error = PQresultErrorMessage(raw);
+  }
+
+  if(!error.empty()) throw std::runtime_error(std::format("[ERROR: in 'async::exec()'] => {}", error));
+  if(!last) throw std::runtime_error("[ERROR: in 'async::exec()'] => Query returned no result.");
+  co_return std::move(*last);
+}
+
+Task<void> execute(std::string sql_string, std::vector<std::string> params){
+  co_await exec(std::move(sql_string), std::move(params));
+}
+}
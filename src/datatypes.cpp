@@ -2,8 +2,8 @@
 #include <variant>
 #include "../strata/db_adapters.hpp"
 
-IntegerField::IntegerField(std::string datatype, bool pk, bool not_null, bool unique, int check_constr, std::string check_cond)
-:FieldAttr("int", datatype, not_null, unique, pk), check_constraint(check_constr), check_condition(check_cond)
+IntegerField::IntegerField(std::string datatype, bool pk, bool not_null, bool unique, int check_constr, std::string check_cond, bool db_index)
+:FieldAttr("int", datatype, not_null, unique, pk, db_index), check_constraint(check_constr), check_condition(check_cond)
 {
   db_adapter::generate_int_sql(*this);
 }
@@ -15,7 +15,8 @@ void to_json(nlohmann::json& j, const IntegerField& field){
     {"unique", field.unique},
     {"primary_key", field.primary_key},
     {"check_constraint", field.check_constraint},
-    {"check_condition", field.check_condition}
+    {"check_condition", field.check_condition},
+    {"db_index", field.db_index}
   };
 }
 
@@ -26,11 +27,12 @@ void from_json(const nlohmann::json& j, IntegerField& field){
   field.primary_key = j.at("primary_key").get<bool>();
   field.check_constraint = j.at("check_constraint").get<int>();
   field.check_condition = j.at("check_condition").get<std::string>();
+  field.db_index = j.value("db_index", false);
   db_adapter::generate_int_sql(field);
 }
 
-DecimalField::DecimalField(std::string datatype, int max_length, int decimal_places, bool pk)
-  :FieldAttr("float", datatype, false, false, pk), max_length(max_length), decimal_places(decimal_places)
+DecimalField::DecimalField(std::string datatype, int max_length, int decimal_places, bool pk, bool db_index)
+  :FieldAttr("float", datatype, false, false, pk, db_index), max_length(max_length), decimal_places(decimal_places)
 {
   db_adapter::generate_decimal_sql(*this);
 }
@@ -40,7 +42,8 @@ void to_json(nlohmann::json& j, const DecimalField& field){
     {"datatype", field.datatype},
     {"primary_key", field.primary_key},
     {"max_length", field.max_length},
-    {"dec_places", field.decimal_places}
+    {"dec_places", field.decimal_places},
+    {"db_index", field.db_index}
   };
 }
 
@@ -49,11 +52,12 @@ void from_json(const nlohmann::json& j, DecimalField& field){
   field.primary_key = j.at("primary_key").get<bool>();
   field.max_length = j.at("max_length").get<int>();
   field.decimal_places = j.at("dec_places").get<int>();
+  field.db_index = j.value("db_index", false);
   db_adapter::generate_decimal_sql(field);
 }
 
-CharField::CharField(std::string datatype, int length, bool not_null, bool unique, bool pk)
-  :FieldAttr("std::string", datatype, not_null, unique, pk), length(length)
+CharField::CharField(std::string datatype, int length, bool not_null, bool unique, bool pk, bool db_index)
+  :FieldAttr("std::string", datatype, not_null, unique, pk, db_index), length(length)
 {
   db_adapter::generate_char_sql(*this);
 }
@@ -64,7 +68,8 @@ void to_json(nlohmann::json& j, const CharField& field){
     {"not_null", field.not_null},
     {"unique", field.unique},
     {"primary_key", field.primary_key},
-    {"length", field.length}
+    {"length", field.length},
+    {"db_index", field.db_index}
   };
 }
 
@@ -74,11 +79,12 @@ void from_json(const nlohmann::json& j, CharField& field){
   field.unique = j.at("unique").get<bool>();
   field.primary_key = j.at("primary_key").get<bool>();
   field.length = j.at("length").get<int>();
+  field.db_index = j.value("db_index", false);
   db_adapter::generate_char_sql(field);
 }
 
-BoolField::BoolField(bool not_null, bool enable_default, bool default_value)
-:FieldAttr("bool", "BOOLEAN", not_null, false, false), enable_default(enable_default), default_value(default_value)
+BoolField::BoolField(bool not_null, bool enable_default, bool default_value, bool db_index)
+:FieldAttr("bool", "BOOLEAN", not_null, false, false, db_index), enable_default(enable_default), default_value(default_value)
 {
   db_adapter::generate_bool_sql(*this);
 }
@@ -87,7 +93,8 @@ void to_json(nlohmann::json& j, const BoolField& field){
   j = nlohmann::json{
     {"not_null", field.not_null},
     {"enable_def", field.enable_default},
-    {"default", field.default_value}
+    {"default", field.default_value},
+    {"db_index", field.db_index}
   };
 }
 
@@ -96,11 +103,12 @@ void from_json(const nlohmann::json& j, BoolField& field){
   field.not_null = j.at("not_null").get<bool>();
   field.enable_default = j.at("enable_def").get<bool>();
   field.default_value = j.at("default").get<bool>();
+  field.db_index = j.value("db_index", false);
   db_adapter::generate_bool_sql(field);
 }
 
-BinaryField::BinaryField(bool not_null, bool unique, bool pk)
-:FieldAttr("int", "BYTEA", not_null, unique, pk)
+BinaryField::BinaryField(bool not_null, bool unique, bool pk, bool db_index)
+:FieldAttr("int", "BYTEA", not_null, unique, pk, db_index)
 {
   db_adapter::generate_bin_sql(*this);
 }
@@ -110,6 +118,7 @@ void to_json(nlohmann::json& j, const BinaryField& field){
     {"not_null", field.not_null},
     {"unique", field.unique},
     {"primary_key", field.primary_key},
+    {"db_index", field.db_index}
   };
 }
 
@@ -118,11 +127,12 @@ void from_json(const nlohmann::json& j, BinaryField& field){
   field.not_null = j.at("not_null").get<bool>();
   field.unique = j.at("unique").get<bool>();
   field.primary_key = j.at("primary_key").get<bool>();
+  field.db_index = j.value("db_index", false);
   db_adapter::generate_bin_sql(field);
 }
 
-DateTimeField::DateTimeField(std::string datatype, bool enable_default, std::string default_val, bool pk)
-:FieldAttr("std::string",datatype, false, false, pk), enable_default(enable_default), default_val(default_val)
+DateTimeField::DateTimeField(std::string datatype, bool enable_default, std::string default_val, bool pk, bool db_index)
+:FieldAttr("std::string",datatype, false, false, pk, db_index), enable_default(enable_default), default_val(default_val)
 {
   db_adapter::generate_datetime_sql(*this);
 }
@@ -132,7 +142,8 @@ void to_json(nlohmann::json& j, const DateTimeField& field){
     {"datatype", field.datatype},
     {"primary_key", field.primary_key},
     {"default_value", field.default_val},
-    {"enable_def", field.enable_default}
+    {"enable_def", field.enable_default},
+    {"db_index", field.db_index}
   };
 }
 
@@ -141,11 +152,12 @@ void from_json(const nlohmann::json& j, DateTimeField& field){
   field.primary_key = j.at("primary_key").get<bool>();
   field.enable_default = j.at("enable_def").get<bool>();
   field.default_val = j.at("default_value").get<std::string>();
+  field.db_index = j.value("db_index", false);
   db_adapter::generate_datetime_sql(field);
 }
 
-ForeignKey::ForeignKey(std::string cn, std::string mn, std::string rcn, std::optional<FieldAttr> pk_col_obj, std::string on_del, std::string on_upd)
-:FieldAttr("null", "FOREIGN KEY", false, false, false),
+ForeignKey::ForeignKey(std::string cn, std::string mn, std::string rcn, std::optional<FieldAttr> pk_col_obj, std::string on_del, std::string on_upd, bool db_index)
+:FieldAttr("null", "FOREIGN KEY", false, false, false, db_index),
 col_name(cn), model_name(mn), ref_col_name(rcn), on_delete(on_del), on_update(on_upd)
 {
 
@@ -167,6 +179,7 @@ void to_json(nlohmann::json& j, const ForeignKey& field){
     {"referenced_column_name", field.ref_col_name},
     {"on_delete", field.on_delete},
     {"on_update", field.on_update},
+    {"db_index", field.db_index}
   };
 }
 
@@ -177,6 +190,8 @@ void from_json(const nlohmann::json& j, ForeignKey& field){
   field.ref_col_name = j.at("referenced_column_name").get<std::string>();
   field.on_delete = j.at("on_delete").get<std::string>();
   field.on_update = j.at("on_update").get<std::string>(); 
+  //Schema files written before foreign keys were indexed read as unindexed, so the next migration adds the index.
+  field.db_index = j.value("db_index", false);
   db_adapter::generate_foreignkey_sql(field);
 }
 
@@ -1,9 +1,20 @@
+#include <algorithm>
 #include <cctype>
+#include <bit>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
 #include <ios>
+#include <limits>
+#include <optional>
+#include <random>
 #include <iostream>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <tuple>
 #include "../strata/db_adapters.hpp"
 
 std::string str_to_upper(std::string& str){
@@ -13,13 +24,19 @@ std::string str_to_upper(std::string& str){
   return str;
 }
 
-Utils::db_params Utils::parse_db_conn_params(){
+nlohmann::json load_db_config(){
   std::ifstream dbconfigfile ("config.json");
 
   if(!dbconfigfile.is_open()) throw std::runtime_error("[ERROR: in 'parse_db_conn_params()']Could not load db params from config.json.");
 
   nlohmann::json j;
   dbconfigfile >> j;
+  return j;
+}
+
+Utils::db_params Utils::parse_db_conn_params(){
+  nlohmann::json j = load_db_config();
+  if(j.contains("primary")) j = j.at("primary");
 //NOTE intro a try catch here for more informative error handling
   return Utils::db_params { j.at("db_name").get<std::string>(),
                      j.at("user").get<std::string>(),
@@ -29,15 +46,400 @@ Utils::db_params Utils::parse_db_conn_params(){
                    };
 }
 
+std::vector<Utils::db_params> parse_node_list(const std::string& key){
+  nlohmann::json j = load_db_config();
+  std::vector<Utils::db_params> nodes {};
+  if(!j.contains(key)) return nodes;
+
+  Utils::db_params primary = Utils::parse_db_conn_params();
+  for(const nlohmann::json& node : j.at(key)){
+    nodes.push_back(Utils::db_params { node.value("db_name", primary.db_name),
+                                       node.value("user", primary.user),
+                                       node.value("passwd", primary.passwd),
+                                       node.value("host", primary.host),
+                                       node.value("port", primary.port)
+                                     });
+  }
+  return nodes;
+}
+
+std::vector<Utils::db_params> Utils::parse_replica_conn_params(){
+  return parse_node_list("replicas");
+}
+
+std::vector<Utils::db_params> Utils::parse_shard_conn_params(){
+  return parse_node_list("shards");
+}
+
 namespace psql{
 
+Router::Router(): primary(Utils::parse_db_conn_params()){
+  for(Utils::db_params& params : Utils::parse_replica_conn_params()){
+    replicas.push_back(Replica{std::move(params)});
+  }
+}
+
+Router& Router::instance(){
+  static Router router {};
+  return router;
+}
+
+int Router::pick_replica(const std::vector<int>& tried){
+  static thread_local std::mt19937 rng {std::random_device{}()};
+  auto now = std::chrono::steady_clock::now();
+  std::vector<int> healthy {};
+
+  std::lock_guard<std::mutex> lock(mtx);
+  for(int i = 0; i < static_cast<int>(replicas.size()); ++i){
+    if(replicas[i].ejected_until <= now && std::find(tried.begin(), tried.end(), i) == tried.end()) healthy.push_back(i);
+  }
+  if(healthy.empty()) return -1;
+  if(healthy.size() == 1) return healthy[0];
+
+  std::uniform_int_distribution<std::size_t> dist(0, healthy.size() - 1);
+  int a = healthy[dist(rng)];
+  int b = healthy[dist(rng)];
+  return replicas[a].latency_ms <= replicas[b].latency_ms ? a : b;
+}
+
+void Router::observe(int replica, std::chrono::steady_clock::duration latency, bool ok){
+  std::lock_guard<std::mutex> lock(mtx);
+  Replica& node = replicas[replica];
+  if(ok){
+    double sample = std::chrono::duration<double, std::milli>(latency).count();
+    node.latency_ms = node.failures == 0 && node.latency_ms == 0 ? sample : 0.8 * node.latency_ms + 0.2 * sample;
+    node.failures = 0;
+    return;
+  }
+  node.failures = std::min(node.failures + 1, 6);
+  node.ejected_until = std::chrono::steady_clock::now() + std::chrono::seconds(1 << node.failures);
+}
+
+void Router::observe(const pqxx::connection& cxn, std::chrono::steady_clock::duration latency, bool ok){
+  std::string host = cxn.hostname();
+  std::string port = cxn.port();
+  for(int i = 0; i < static_cast<int>(replicas.size()); ++i){
+    if(replicas[i].params.host == host && std::to_string(replicas[i].params.port) == port){
+      observe(i, latency, ok);
+      return;
+    }
+  }
+}
+
+Session& Session::current(){
+  thread_local Session session {};
+  return session;
+}
+
+std::uint64_t Session::parse_lsn(const std::string& lsn){
+  std::string::size_type slash = lsn.find('/');
+  if(slash == std::string::npos) throw std::runtime_error(std::format("[ERROR: in 'Session::parse_lsn()'] => Invalid LSN '{}'.", lsn));
+  return (std::stoull(lsn.substr(0, slash), nullptr, 16) << 32) | std::stoull(lsn.substr(slash + 1), nullptr, 16);
+}
+
+std::string Session::format_lsn(std::uint64_t lsn){
+  return std::format("{:X}/{:X}", lsn >> 32, lsn & 0xFFFFFFFF);
+}
+
+void Session::record_write(pqxx::connection& cxn){
+  if(!Router::instance().has_replicas()) return;
+  pqxx::nontransaction txn(cxn);
+  std::uint64_t lsn = parse_lsn(txn.query_value<std::string>("select pg_current_wal_lsn()::text"));
+  last_write_lsn = std::max(last_write_lsn, lsn);
+}
+
+bool Session::caught_up(pqxx::connection& replica_cxn) const{
+  if(last_write_lsn == 0) return true;
+  pqxx::nontransaction txn(replica_cxn);
+  return txn.query_value<bool>("select coalesce(pg_last_wal_replay_lsn() >= $1::pg_lsn, true)",
+                               pqxx::params{format_lsn(last_write_lsn)});
+}
+
+Deadline::Deadline(pqxx::connection& cxn, pqxx::transaction_base& txn, std::chrono::milliseconds timeout){
+  if(timeout.count() <= 0) return;
+  txn.exec("set local statement_timeout = " + std::to_string(timeout.count()));
+  cancel = [&cxn]{ cxn.cancel_query(); };
+  arm(timeout);
+}
+
+Deadline::Deadline(PGconn* raw, std::chrono::milliseconds timeout){
+  if(timeout.count() <= 0) return;
+  binary::Result set {PQexec(raw, ("set local statement_timeout = " + std::to_string(timeout.count())).c_str())};
+  if(PQresultStatus(set.get()) != PGRES_COMMAND_OK)
+    throw std::runtime_error(std::format("[ERROR: in 'Deadline()'] => {}", PQerrorMessage(raw)));
+
+  std::shared_ptr<PGcancel> handle(PQgetCancel(raw), &PQfreeCancel);
+  cancel = [handle]{
+    char err[256];
+    if(handle) PQcancel(handle.get(), err, sizeof(err));
+  };
+  arm(timeout);
+}
+
+void Deadline::arm(std::chrono::milliseconds timeout){
+  auto cancel_at = std::chrono::steady_clock::now() + timeout + std::max(timeout / 10, std::chrono::milliseconds(50));
+  watchdog = std::thread([this, cancel_at]{
+    std::unique_lock<std::mutex> lock(mtx);
+    if(!cv.wait_until(lock, cancel_at, [this]{ return finished; })) cancel();
+  });
+}
+
+Deadline::~Deadline(){
+  if(!watchdog.joinable()) return;
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    finished = true;
+  }
+  cv.notify_one();
+  watchdog.join();
+}
+
+Pool& Pool::instance(){
+  static Pool pool {};
+  return pool;
+}
+
+Pool::Lease Pool::acquire(Route route){
+  //Without replicas every read is served by the primary, so its idle connections serve both routes.
+  Route node = route == REPLICA && Router::instance().has_replicas() ? REPLICA : PRIMARY;
+  //Replica connections that haven't replayed the session's last write yet are set aside and returned to the pool
+  //afterwards: they are still good for other sessions, and for this one once replay catches up.
+  std::vector<std::unique_ptr<PooledConnection>> lagging {};
+  auto restore = [&]{
+    for(std::unique_ptr<PooledConnection>& conn : lagging) release(std::move(conn));
+  };
+  while(true){
+    std::unique_ptr<PooledConnection> conn {};
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      std::vector<std::unique_ptr<PooledConnection>>& idle = node == PRIMARY ? idle_primary : idle_replica;
+      if(idle.empty()) break;
+      conn = std::move(idle.back());
+      idle.pop_back();
+    }
+    if(!conn->cxn.is_open()) continue;
+    if(node == REPLICA){
+      bool ready = false;
+      try{
+        ready = Session::current().caught_up(conn->cxn);
+      }catch(const std::exception&){
+        //A failed probe only rules out this connection; release() drops it if it is broken.
+      }
+      if(!ready){
+        lagging.push_back(std::move(conn));
+        continue;
+      }
+    }
+    restore();
+    return Lease{*this, std::move(conn)};
+  }
+  restore();
+
+  Route served_by = PRIMARY;
+  pqxx::connection cxn = connect(route, &served_by);
+  return Lease{*this, std::make_unique<PooledConnection>(PooledConnection{std::move(cxn), served_by})};
+}
+
+//Connections are pooled by the node they reached, so a primary handed out as a replica fallback
+//goes back to idle_primary instead of serving reads indefinitely.
+void Pool::release(std::unique_ptr<PooledConnection> conn){
+  if(!conn->cxn.is_open()) return;
+  std::lock_guard<std::mutex> lock(mtx);
+  std::vector<std::unique_ptr<PooledConnection>>& idle = conn->node == PRIMARY ? idle_primary : idle_replica;
+  if(idle.size() < max_idle) idle.push_back(std::move(conn));
+}
+
+std::string Pool::Lease::prepare(const std::string& sql_string){
+  std::string name = std::format("strata_{:x}", Utils::fnv1a(sql_string));
+  if(auto it = conn->prepared.find(name); it != conn->prepared.end()){
+    conn->recent.splice(conn->recent.begin(), conn->recent, it->second);
+    return name;
+  }
+
+  while(!conn->recent.empty() && conn->prepared.size() >= pool->max_prepared){
+    conn->cxn.unprepare(conn->recent.back());
+    conn->prepared.erase(conn->recent.back());
+    conn->recent.pop_back();
+  }
+  conn->cxn.prepare(name, sql_string);
+  conn->recent.push_front(name);
+  conn->prepared[name] = conn->recent.begin();
+  return name;
+}
+
+bool Router::wait_for_replay(pqxx::connection& cxn, const Session& session, std::chrono::steady_clock::time_point deadline){
+  while(!session.caught_up(cxn)){
+    if(std::chrono::steady_clock::now() >= deadline) return false;
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  return true;
+}
+
+pqxx::connection Router::connect(Route route, Route* served_by){
+  if(route == REPLICA){
+    const Session& session = Session::current();
+    auto deadline = std::chrono::steady_clock::now() + session.replica_wait;
+    std::vector<int> tried {};
+    for(int replica = pick_replica(tried); replica >= 0; replica = pick_replica(tried)){
+      tried.push_back(replica);
+      auto start = std::chrono::steady_clock::now();
+      try{
+        pqxx::connection cxn(conn_string(replicas[replica].params));
+        observe(replica, std::chrono::steady_clock::now() - start, true);
+        if(wait_for_replay(cxn, session, deadline)){
+          if(served_by) *served_by = REPLICA;
+          return cxn;
+        }
+      }catch(const std::exception& e){
+        observe(replica, std::chrono::steady_clock::now() - start, false);
+      }
+    }
+  }
+  if(served_by) *served_by = PRIMARY;
+  return pqxx::connection(conn_string(primary));
+}
+
+namespace shard{
+
+const std::vector<Utils::db_params>& shard_params(){
+  static const std::vector<Utils::db_params> shards = Utils::parse_shard_conn_params();
+  return shards;
+}
+
+std::size_t count(){
+  return shard_params().size();
+}
+
+std::size_t shard_for(std::string_view key){
+  if(count() == 0) throw std::runtime_error("[ERROR: in 'shard::shard_for()'] => No shards are listed in config.json.");
+  return Utils::fnv1a(key) % count();
+}
+
+pqxx::connection connect(std::size_t shard){
+  try{
+    return pqxx::connection(conn_string(shard_params().at(shard)));
+  }catch (const std::exception& e){
+    throw std::runtime_error(std::format("[ERROR: in 'shard::connect()'] => {}", e.what()));
+  }
+}
+
+bool less(const pqxx::field& a, const pqxx::field& b, Oid type){
+  if(a.is_null() || b.is_null()) return !a.is_null() && b.is_null();
+  switch(type){
+    case binary::INT2OID:
+    case binary::INT4OID:
+    case binary::INT8OID: return a.as<long long>() < b.as<long long>();
+    case binary::FLOAT4OID:
+    case binary::FLOAT8OID:
+    case binary::NUMERICOID: return a.as<double>() < b.as<double>();
+    default: return a.view() < b.view();
+  }
+}
+
+std::vector<pqxx::row> merge(std::vector<pqxx::result>& results, const std::optional<OrderBy>& order, std::optional<std::size_t> limit){
+  std::vector<pqxx::row> rows {};
+  std::size_t max_rows = limit.value_or(std::numeric_limits<std::size_t>::max());
+
+  if(!order){
+    for(const pqxx::result& result : results){
+      for(const pqxx::row& row : result){
+        if(rows.size() == max_rows) return rows;
+        rows.push_back(row);
+      }
+    }
+    return rows;
+  }
+
+  std::vector<pqxx::result::size_type> cursors(results.size(), 0);
+  while(rows.size() < max_rows){
+    int best = -1;
+    for(std::size_t i = 0; i < results.size(); ++i){
+      if(cursors[i] >= results[i].size()) continue;
+      if(best < 0){
+        best = static_cast<int>(i);
+        continue;
+      }
+      int col = results[i].column_number(order->column);
+      Oid type = results[i].column_type(col);
+      const pqxx::field candidate = results[i][cursors[i]][col];
+      const pqxx::field current = results[best][cursors[best]][col];
+      if(order->descending ? less(current, candidate, type) : less(candidate, current, type)) best = static_cast<int>(i);
+    }
+    if(best < 0) break;
+    rows.push_back(results[best][cursors[best]++]);
+  }
+  return rows;
+}
+}
+
 void alter_rename_table(const std::string& old_model_name, const std::string& new_model_name, std::ofstream& Migrations){
   Migrations<< "ALTER TABLE " + old_model_name + " RENAME TO " + new_model_name + ";\n";
 }
 
+void AlterBatch::add(const std::string& model_name, std::string action, AlterCost cost){
+  auto it = std::find_if(tables.begin(), tables.end(), [&](const TableActions& table){ return table.model_name == model_name; });
+  if(it == tables.end()) it = tables.insert(tables.end(), TableActions{model_name});
+  it->actions.push_back(std::move(action));
+  it->cost = std::max(it->cost, cost);
+}
+
+void AlterBatch::after(std::string statement){
+  trailing.push_back(Trailing{std::move(statement)});
+}
+
+void AlterBatch::after(const std::string& model_name, std::string statement, AlterCost cost){
+  trailing.push_back(Trailing{std::move(statement), model_name, cost});
+}
+
+std::string human_size(std::int64_t bytes){
+  const char* units[] = {"B", "kB", "MB", "GB", "TB"};
+  double size = static_cast<double>(bytes);
+  int unit = 0;
+  for(; size >= 1024 && unit < 4; ++unit) size /= 1024;
+  return std::format("{:.1f} {}", size, units[unit]);
+}
+
+void AlterBatch::flush(std::ofstream& Migrations){
+  std::optional<pqxx::connection> cxn {};
+  try{
+    cxn.emplace(connect(PRIMARY));
+  }catch(const std::exception&){
+    //Sizes are an estimate; migrations are still generated without a reachable database.
+  }
+
+  auto cost_label = [&](const std::string& model_name, AlterCost cost){
+    std::string label = cost == REWRITE ? "full rewrite" : cost == SCAN ? "validating scan" : "metadata-only";
+    if(cxn && cost != METADATA){
+      try{
+        pqxx::nontransaction ntxn(*cxn);
+        pqxx::result size = ntxn.exec("select pg_total_relation_size(c.oid), greatest(c.reltuples, 0)::bigint from pg_class c "
+                                      "where c.relname = $1 and c.relkind in ('r', 'p')", pqxx::params{model_name});
+        if(!size.empty())
+          label += " of ~" + human_size(size[0][0].as<std::int64_t>()) + ", ~" + std::to_string(size[0][1].as<std::int64_t>()) + " rows";
+      }catch(const std::exception&){}
+    }
+    std::cout<<"[migrations] "<<model_name<<": "<<label<<std::endl;
+    Migrations<< "-- strata:cost " + model_name + " " + label + "\n";
+  };
+
+  for(const TableActions& table : tables){
+    cost_label(table.model_name, table.cost);
+    Migrations<< "ALTER TABLE " + table.model_name + "\n  " + Utils::join(table.actions, ",\n  ") + ";\n";
+  }
+  for(const Trailing& step : trailing){
+    if(step.cost != METADATA) cost_label(step.model_name, step.cost);
+    Migrations<< step.statement + (step.statement.starts_with("--") ? "\n" : ";\n");
+  }
+  tables.clear();
+  trailing.clear();
+}
+
 void alter_add_column(const std::string& model_name, const std::string& column_name,
-                      const std::string& column_sql_attributes, std::ofstream& Migrations){
-  Migrations<< "ALTER TABLE " + model_name + " ADD COLUMN " + column_name + " " + column_sql_attributes + ";\n";
+                      const std::string& column_sql_attributes, AlterBatch& batch){
+  std::string upper = column_sql_attributes;
+  str_to_upper(upper);
+  bool needs_scan = upper.find("NOT NULL") != std::string::npos && upper.find("DEFAULT") == std::string::npos;
+  batch.add(model_name, "ADD COLUMN " + column_name + " " + column_sql_attributes, needs_scan ? SCAN : METADATA);
 }
 
 void alter_rename_column(const std::string& model_name, const std::string& old_column_name,
@@ -45,43 +447,205 @@ void alter_rename_column(const std::string& model_name, const std::string& old_c
   Migrations << "ALTER TABLE " + model_name + " RENAME COLUMN " + old_column_name + " TO " + new_column_name + ";\n";
 }
 
+//Only widening a length or precision limit, or dropping it, is binary compatible and skips the rewrite.
+AlterCost type_change_cost(const std::string& from_sql, const std::string& to_sql){
+  auto parse = [](std::string type_sql){
+    str_to_upper(type_sql);
+    type_sql.erase(std::remove(type_sql.begin(), type_sql.end(), ' '), type_sql.end());
+    if(type_sql.starts_with("DECIMAL")) type_sql.replace(0, 7, "NUMERIC");
+    if(type_sql.starts_with("CHARACTERVARYING")) type_sql.replace(0, 16, "VARCHAR");
+
+    std::string name = type_sql.substr(0, type_sql.find('('));
+    int precision = -1, scale = 0;
+    if(std::size_t open = type_sql.find('('); open != std::string::npos)
+      std::sscanf(type_sql.c_str() + open, "(%d,%d)", &precision, &scale);
+    return std::make_tuple(name, precision, scale);
+  };
+  auto [from, from_precision, from_scale] = parse(from_sql);
+  auto [to, to_precision, to_scale] = parse(to_sql);
+
+  if(from == "VARCHAR" && to == "TEXT") return METADATA;
+  if(from == to && (from == "VARCHAR" || from == "NUMERIC")){
+    if(to_precision < 0) return METADATA;
+    if(from_precision >= 0 && to_precision >= from_precision && to_scale == from_scale) return METADATA;
+  }
+  if(from == to && from_precision == to_precision && from_scale == to_scale) return METADATA;
+  return REWRITE;
+}
+
 void alter_column_type(const std::string& model_name, const std::string& column_name,
-                       const std::string& sql_segment, std::ofstream& Migrations){
-  Migrations<< "ALTER TABLE " + model_name + " ALTER COLUMN " + column_name + " TYPE " + sql_segment + ";\n";
+                       const std::string& sql_segment, AlterBatch& batch, AlterCost cost){
+  batch.add(model_name, "ALTER COLUMN " + column_name + " TYPE " + sql_segment, cost);
+}
+
+void expand_contract_column(const std::string& model_name, const std::string& column_name, const std::string& sql_segment,
+                            const FieldAttr& field, const std::string& default_sql, const std::string& fill_sql,
+                            const std::map<std::string, Index>& indexes, bool partitioned, AlterBatch& batch){
+  if(field.primary_key)
+    throw std::runtime_error(std::format("[ERROR: in 'expand_contract_column()'] => '{}.{}' is part of the primary key; "
+                                         "change its type with a plain ALTER instead.", model_name, column_name));
+  if(field.unique && partitioned)
+    throw std::runtime_error(std::format("[ERROR: in 'expand_contract_column()'] => Unique column '{}.{}' of a partitioned table "
+                                         "can't be swapped without a rewrite.", model_name, column_name));
+
+  std::string shadow = column_name + "__new", retired = column_name + "__old";
+  std::string sync = "strata_sync_" + model_name + "_" + column_name;
+  std::string base_type = sql_segment.substr(0, sql_segment.find('('));
+  base_type.erase(base_type.find_last_not_of(' ') + 1);
+  std::string cast = column_name + "::" + base_type;
+  if(field.not_null && !fill_sql.empty()) cast = "COALESCE(" + cast + ", " + fill_sql + ")";
+
+  //Replaces whole-word uses of the column, so index columns and predicates can be rebuilt on the shadow column.
+  auto on_shadow = [&](const std::string& text){
+    std::string out {};
+    for(std::size_t i = 0; i < text.size();){
+      auto is_word = [&](std::size_t at){ return at < text.size() && (std::isalnum(static_cast<unsigned char>(text[at])) || text[at] == '_'); };
+      if(text.compare(i, column_name.size(), column_name) == 0 && (i == 0 || !is_word(i - 1)) && !is_word(i + column_name.size())){
+        out += shadow;
+        i += column_name.size();
+      }else{
+        out += text[i++];
+      }
+    }
+    return out;
+  };
+  auto staging_name = [](const std::string& name){
+    return std::format("{}_{:08x}", name.substr(0, 54), static_cast<std::uint32_t>(Utils::fnv1a(name + "__new")));
+  };
+
+  batch.add(model_name, "ADD COLUMN " + shadow + " " + sql_segment);
+  batch.after("CREATE OR REPLACE FUNCTION " + sync + "() RETURNS trigger AS $$ BEGIN NEW." + shadow + " := NEW." + cast +
+              "; RETURN NEW; END $$ LANGUAGE plpgsql");
+  batch.after("CREATE TRIGGER " + sync + " BEFORE INSERT OR UPDATE ON " + model_name + " FOR EACH ROW EXECUTE FUNCTION " + sync + "()");
+  if(!default_sql.empty()) batch.after("ALTER TABLE " + model_name + " ALTER COLUMN " + shadow + " SET DEFAULT " + default_sql);
+  batch.after(std::string(backfill_directive) + model_name + " " + shadow + " " + cast);
+
+  if(field.not_null){
+    std::string check_name = "nn_" + model_name + "_" + shadow;
+    batch.after("ALTER TABLE " + model_name + " ADD CONSTRAINT " + check_name + " CHECK (" + shadow + " IS NOT NULL) NOT VALID");
+    batch.after(model_name, "ALTER TABLE " + model_name + " VALIDATE CONSTRAINT " + check_name, SCAN);
+    batch.after("ALTER TABLE " + model_name + " ALTER COLUMN " + shadow + " SET NOT NULL");
+    batch.after("ALTER TABLE " + model_name + " DROP CONSTRAINT " + check_name);
+  }
+
+  //Replacement indexes are built next to the old ones under staging names and take over the names after the swap.
+  std::vector<std::pair<std::string, std::string>> index_renames {};
+  std::string unique_index {};
+  if(field.unique){
+    unique_index = staging_name("uq_" + column_name);
+    batch.after(index_sql(model_name, Index{{shadow}, "btree", "", true, unique_index}, true));
+  }
+  for(const auto& [name, index] : indexes){
+    Index rebuilt = index;
+    for(std::string& column : rebuilt.columns) column = on_shadow(column);
+    rebuilt.where = on_shadow(rebuilt.where);
+    if(rebuilt.columns == index.columns && rebuilt.where == index.where) continue;
+    rebuilt.name = staging_name(name);
+    batch.after(index_sql(model_name, rebuilt, !partitioned));
+    index_renames.emplace_back(rebuilt.name, name);
+  }
+
+  //Until the swap commits, writes to the old column have to keep reaching the shadow one.
+  batch.after(std::string(begin_directive));
+  batch.after("DROP TRIGGER " + sync + " ON " + model_name);
+  batch.after("DROP FUNCTION " + sync + "()");
+  batch.after("ALTER TABLE " + model_name + " RENAME COLUMN " + column_name + " TO " + retired);
+  batch.after("ALTER TABLE " + model_name + " RENAME COLUMN " + shadow + " TO " + column_name);
+  batch.after("ALTER TABLE " + model_name + " DROP COLUMN " + retired);
+  if(field.unique)
+    batch.after("ALTER TABLE " + model_name + " ADD CONSTRAINT uq_" + column_name + " UNIQUE USING INDEX " + unique_index);
+  for(const auto& [staged, name] : index_renames) batch.after("ALTER INDEX " + staged + " RENAME TO " + name);
+  batch.after(std::string(commit_directive));
 }
 
 void alter_column_defaultval(const std::string& model_name, const std::string& column_name,
-                             const bool set_default, const std::string& defaultval, std::ofstream& Migrations){
+                             const bool set_default, const std::string& defaultval, AlterBatch& batch){
   if(set_default){
-    Migrations << "ALTER TABLE " + model_name + " ALTER COLUMN " + column_name + " SET DEFAULT " + defaultval + ";\n";
+    batch.add(model_name, "ALTER COLUMN " + column_name + " SET DEFAULT " + defaultval);
   }else{
-    Migrations<< "ALTER TABLE " + model_name + " ALTER COLUMN " + column_name + " DROP DEFAULT;\n";
+    batch.add(model_name, "ALTER COLUMN " + column_name + " DROP DEFAULT");
   }
 }
 
-void alter_column_nullable(const std::string& model_name, const std::string& column_name, const bool nullable, std::ofstream& Migrations){
+void alter_column_nullable(const std::string& model_name, const std::string& column_name, const bool nullable, AlterBatch& batch,
+                           const std::string& fill_value){
   if(nullable){
-    Migrations<< "ALTER TABLE " + model_name + " ALTER COLUMN " + column_name + " DROP NOT NULL;\n";
-  }else{
-    std::string default_value;
-    std::cout<<"Provide a default value for the column '" + column_name +"' to be set to non-nullable: " << std::endl;
-    std::cin>> default_value;
-    Migrations<< std::boolalpha
-      << "UPDATE " + model_name + " SET " + column_name + " = " + default_value + " WHERE " + column_name
-      << " IS NULL;\n ALTER TABLE " + model_name + " ALTER COLUMN " + column_name + " SET NOT NULL;\n";
+    batch.add(model_name, "ALTER COLUMN " + column_name + " DROP NOT NULL");
+    return;
   }
+  std::string check_name = "nn_" + model_name + "_" + column_name;
+  batch.add(model_name, "ADD CONSTRAINT " + check_name + " CHECK (" + column_name + " IS NOT NULL) NOT VALID");
+  if(!fill_value.empty()) batch.after(std::string(backfill_directive) + model_name + " " + column_name + " " + fill_value);
+  batch.after(model_name, "ALTER TABLE " + model_name + " VALIDATE CONSTRAINT " + check_name, SCAN);
+  //Separate statements: within one ALTER the DROP pass runs before SET NOT NULL, which would then miss the check and scan.
+  batch.after("ALTER TABLE " + model_name + " ALTER COLUMN " + column_name + " SET NOT NULL");
+  batch.after("ALTER TABLE " + model_name + " DROP CONSTRAINT " + check_name);
 }
 
 void drop_table(const std::string& model_name, std::ofstream& Migrations){
   Migrations << "DROP TABLE IF EXISTS " + model_name + ";\n";
 }
 
-void drop_column(const std::string& model_name, const std::string& column_name,  std::ofstream& Migrations){
-  Migrations << "ALTER TABLE " + model_name + " DROP COLUMN " + column_name + ";\n";
+void drop_column(const std::string& model_name, const std::string& column_name, AlterBatch& batch){
+  batch.add(model_name, "DROP COLUMN " + column_name);
+}
+
+void drop_constraint(const std::string& model_name, const std::string& constraint_name, AlterBatch& batch){
+  batch.add(model_name, "DROP CONSTRAINT " + constraint_name);
+}
+
+std::string index_name(const std::string& model_name, const Index& index){
+  if(!index.name.empty()) return index.name;
+
+  std::string name = "ix_" + model_name;
+  for(const std::string& column : index.columns){
+    name += "_";
+    for(char ch : column){
+      if(std::isalnum(static_cast<unsigned char>(ch))) name += std::tolower(static_cast<unsigned char>(ch));
+      else if(name.back() != '_') name += '_';
+    }
+    while(name.back() == '_') name.pop_back();
+  }
+  //Postgres truncates identifiers at 63 bytes, so long names keep a hash of the full one.
+  if(name.size() > 63) name = std::format("{}_{:08x}", name.substr(0, 54), static_cast<std::uint32_t>(Utils::fnv1a(name)));
+  return name;
+}
+
+std::map<std::string, Index> table_indexes(const std::string& model_name, const fields& field_map, const ModelMeta& meta){
+  std::map<std::string, Index> indexes {};
+
+  for(const auto& [col, dtv_obj] : field_map){
+    std::visit([&](auto& col_obj){
+      if(!col_obj->db_index || col_obj->unique || col_obj->primary_key) return;
+      Index index {{col}};
+      index.name = index_name(model_name, index);
+      indexes[index.name] = index;
+    }, dtv_obj);
+  }
+
+  for(Index index : meta.indexes){
+    if(index.columns.empty())
+      throw std::runtime_error(std::format("[ERROR: in 'table_indexes()'] => Index on '{}' has no columns.", model_name));
+    if(index.method != "btree" && index.method != "hash" && index.method != "gin" && index.method != "gist" && index.method != "brin")
+      throw std::runtime_error(std::format("[ERROR: in 'table_indexes()'] => Unsupported index method '{}' on '{}'.", index.method, model_name));
+    index.name = index_name(model_name, index);
+    indexes[index.name] = index;
+  }
+  return indexes;
+}
+
+std::string index_sql(const std::string& model_name, const Index& index, bool concurrently){
+  return "CREATE " + std::string(index.unique ? "UNIQUE " : "") + "INDEX " + (concurrently ? "CONCURRENTLY " : "")
+         + "IF NOT EXISTS " + index_name(model_name, index) + " ON " + model_name + " USING " + index.method
+         + " (" + Utils::join(index.columns, ", ") + ")" + (index.where.empty() ? "" : " WHERE " + index.where);
+}
+
+void create_index(const std::string& model_name, const Index& index, bool concurrently, std::ofstream& Migrations){
+  Migrations<< index_sql(model_name, index, concurrently) + ";\n";
 }
 
-void drop_constraint(const std::string& model_name, const std::string& constraint_name, std::ofstream& Migrations){
-  Migrations<< "ALTER TABLE " + model_name + " DROP CONSTRAINT " + constraint_name + ";\n";
+void drop_index(const std::string& index_name, bool concurrently, std::ofstream& Migrations){
+  Migrations<< "DROP INDEX " + std::string(concurrently ? "CONCURRENTLY " : "") + "IF EXISTS " + index_name + ";\n";
 }
 
 void generate_int_sql(IntegerField& int_obj){
@@ -167,47 +731,600 @@ void generate_foreignkey_sql(ForeignKey& fk_obj){
   fk_obj.sql_segment += " ON UPDATE " + fk_obj.on_update;
 }
 
-void create_models_hpp(const ms_map& migrations){
-  std::ofstream models_hpp("models.hpp");
-  std::string cols_str {};
+//SQL type of a column without its constraints, used for casts in generated classes.
+std::string column_sql_type(const DataTypeVariant& dtv_obj){
+  return std::visit([](const auto& col_obj) -> std::string {
+    using field_T = std::decay_t<decltype(*col_obj)>;
+    if constexpr(std::is_same_v<field_T, CharField>){
+      return col_obj->datatype == "TEXT" ? col_obj->datatype : col_obj->datatype + "(" + std::to_string(col_obj->length) + ")";
+    }else if constexpr(std::is_same_v<field_T, DecimalField>){
+      if(col_obj->datatype == "REAL" || col_obj->datatype == "DOUBLE PRECISION") return col_obj->datatype;
+      return col_obj->datatype + "(" + std::to_string(col_obj->max_length) + "," + std::to_string(col_obj->decimal_places) + ")";
+    }else if constexpr(std::is_same_v<field_T, ForeignKey>){
+      std::string type = col_obj->sql_type;
+      for(const char* constraint : {" NOT NULL", " DEFAULT", " UNIQUE", " PRIMARY"}) type = type.substr(0, type.find(constraint));
+      if(type == "SERIAL") return "INTEGER";
+      if(type == "BIGSERIAL") return "BIGINT";
+      return type;
+    }else{
+      return col_obj->datatype;
+    }
+  }, dtv_obj);
+}
+
+void create_models_hpp(const ms_map& migrations, const meta_map& meta){
+  std::ostringstream models_hpp;
+  std::string cols_str {}, types_str {}, keys_str {};
 
   if(!migrations.empty())
-    models_hpp<<"#include <string>\n#include <vector>\n"
+    models_hpp<<"#include <array>\n#include <string>\n#include <string_view>\n#include <vector>\n"
               <<"#include <pqxx/row>\n#include <tuple>\n\n";
 
   for(const auto& [model_name, col_map] : migrations){
     models_hpp<<"class " + model_name + "{\npublic:\n"
               <<"  std::string table_name = \"" + model_name + "\";\n  int id;\n";
+    auto meta_it = meta.find(model_name);
+    std::string partition_column = meta_it == meta.end() ? "" : meta_it->second.partition.column;
+    std::size_t key_count = 0;
     for(const auto& [col_name, dtv_obj] : col_map){
       cols_str += col_name + ",";
+      types_str += "\"" + column_sql_type(dtv_obj) + "\",";
       std::visit([&](auto& col_obj){
         models_hpp<< "  " + col_obj->ctype + " " + col_name + ";\n";
+        //Same columns as the uq_ constraint create_table() declares for it.
+        if(col_obj->unique){
+          keys_str += "\"" + col_name + (partition_column.empty() || partition_column == col_name ? "" : "," + partition_column) + "\",";
+          ++key_count;
+        }
       }, dtv_obj);
     }
     cols_str.pop_back();
+
+    std::string placeholders_str {};
+    for(std::size_t i = 1; i <= col_map.size(); ++i) placeholders_str += "$" + std::to_string(i) + ",";
+    placeholders_str.pop_back();
+    std::string select_list = model_name + "_id," + cols_str;
+
     models_hpp<< "  std::vector<pqxx::row> records;\n"
       << "  std::string col_str = \"" + cols_str + "\";\n"
       << "  int col_map_size = " + std::to_string(col_map.size()) + ";\n\n"
+      << "  static constexpr std::string_view select_list = \"" + select_list + "\";\n"
+      << "  static constexpr std::string_view select_sql = \"select " + select_list + " from " + model_name + "\";\n"
+      << "  static constexpr std::string_view insert_sql = \"insert into " + model_name + " (" + cols_str + ") values(" + placeholders_str + ");\";\n"
+      << "  static constexpr std::array<std::string_view, " + std::to_string(col_map.size()) + "> sql_types = {" + types_str + "};\n"
+      << "  static constexpr std::array<std::string_view, " + std::to_string(key_count) + "> unique_keys = {" + keys_str + "};\n";
+
+    if(meta_it != meta.end() && !meta_it->second.shard_key.empty()){
+      models_hpp<< "  std::string shard_key = \"" + meta_it->second.shard_key + "\";\n";
+    }
+
+    models_hpp<< "\n"
       << "  " + model_name + "() = default;\n"
       << "  template <typename tuple_T>\n"
       << "  " + model_name + "(tuple_T tup){\n"
       << "    std::tie(id," + cols_str + ") = tup;\n  }\n\n"
       << "  auto get_attr() const{\n"
-      << "    return std::make_tuple(id," + cols_str + ");\n  }\n};\n\n";
+      << "    return std::make_tuple(id," + cols_str + ");\n  }\n";
+
+    if(meta_it != meta.end() && !meta_it->second.shard_key.empty()){
+      models_hpp<< "\n  auto shard_value() const{\n"
+                << "    return " + meta_it->second.shard_key + ";\n  }\n";
+    }
+    models_hpp<< "};\n\n";
     cols_str.clear();
+    types_str.clear();
+    keys_str.clear();
   }
+
+  //Leave an unchanged models.hpp untouched so its timestamp doesn't trigger recompiles.
+  std::string generated = models_hpp.str();
+  std::ifstream current("models.hpp", std::ios::binary);
+  if(current.is_open() && std::string(std::istreambuf_iterator<char>(current), {}) == generated) return;
+  current.close();
+  std::ofstream("models.hpp", std::ios::binary)<< generated;
 }
 
 void exec_insert(pqxx::connection& cxn, pqxx::params& row){
   try{
     pqxx::work txn(cxn);
-    pqxx::result result = txn.exec(pqxx::prepped{"insert_stmt"}, row).no_rows();
+    {
+      Deadline deadline {cxn, txn};
+      pqxx::result result = txn.exec(pqxx::prepped{"insert_stmt"}, row).no_rows();
+    }
     txn.commit();
+    Session::current().record_write(cxn);
+  }catch(const pqxx::query_canceled& e){
+    throw timeout_error(std::format("[ERROR: in 'exec_insert()'] => {}.", e.what()));
   }catch(const std::exception& e){
     throw std::runtime_error(std::format("[ERROR: in 'exec_insert()'] => {}.", e.what()));
   }
 }
 
+namespace binary{
+
+const timestamp pg_epoch = std::chrono::sys_days{std::chrono::year{2000}/1/1};
+
+Result exec(const std::string& sql_string, const std::vector<std::string>& params){
+  Pool::Lease lease = Pool::instance().acquire(REPLICA);
+  auto start = std::chrono::steady_clock::now();
+
+  std::vector<const char*> values {};
+  values.reserve(params.size());
+  for(const std::string& param : params) values.push_back(param.c_str());
+
+  bool broken = false;
+  try{
+    Result result = lease.with_raw([&](PGconn* raw){
+      auto command = [&](const char* sql){
+        Result status {PQexec(raw, sql)};
+        if(PQresultStatus(status.get()) != PGRES_COMMAND_OK) throw std::runtime_error(PQerrorMessage(raw));
+      };
+
+      command("begin");
+      try{
+        Result rows {nullptr};
+        {
+          Deadline deadline {raw};
+          rows = Result{PQexecParams(raw, sql_string.c_str(), static_cast<int>(values.size()), nullptr, values.data(), nullptr, nullptr, 1)};
+        }
+        if(PQresultStatus(rows.get()) != PGRES_TUPLES_OK){
+          const char* state = PQresultErrorField(rows.get(), PG_DIAG_SQLSTATE);
+          if(state && std::string_view(state) == "57014") throw timeout_error(PQerrorMessage(raw));
+          throw std::runtime_error(PQerrorMessage(raw));
+        }
+        command("commit");
+        return rows;
+      }catch(...){
+        broken = PQstatus(raw) == CONNECTION_BAD;
+        Result rollback {PQexec(raw, "rollback")};
+        throw;
+      }
+    });
+    Router::instance().observe(lease.cxn(), std::chrono::steady_clock::now() - start, true);
+    return result;
+  }catch(const timeout_error& e){
+    throw timeout_error(std::format("[ERROR: in 'binary::exec()'] => {}", e.what()));
+  }catch(const std::exception& e){
+    if(broken) Router::instance().observe(lease.cxn(), std::chrono::steady_clock::now() - start, false);
+    throw std::runtime_error(std::format("[ERROR: in 'binary::exec()'] => {}", e.what()));
+  }
+}
+
+bool is_textual(Oid type){
+  return type == TEXTOID || type == VARCHAROID || type == BPCHAROID || type == NAMEOID || type == BYTEAOID;
+}
+
+std::int64_t decode_int(Oid type, std::string_view raw){
+  switch(type){
+    case INT2OID: return read_be<std::int16_t>(raw.data());
+    case INT4OID: return read_be<std::int32_t>(raw.data());
+    case INT8OID: return read_be<std::int64_t>(raw.data());
+    case OIDOID: return read_be<std::uint32_t>(raw.data());
+    default:
+      throw std::runtime_error(std::format("[ERROR: in 'binary::decode_int()'] => Column of type oid {} is not an integer.", type));
+  }
+}
+
+double numeric_to_double(std::string_view raw){
+  std::int16_t ndigits = read_be<std::int16_t>(raw.data());
+  std::int16_t weight = read_be<std::int16_t>(raw.data() + 2);
+  std::uint16_t sign = read_be<std::uint16_t>(raw.data() + 4);
+
+  if(sign == 0xC000) return std::numeric_limits<double>::quiet_NaN();
+  if(sign == 0xD000) return std::numeric_limits<double>::infinity();
+  if(sign == 0xF000) return -std::numeric_limits<double>::infinity();
+
+  double value = 0;
+  for(int i = 0; i < ndigits; ++i){
+    value += read_be<std::int16_t>(raw.data() + 8 + 2*i) * std::pow(10000.0, weight - i);
+  }
+  return sign == 0x4000 ? -value : value;
+}
+
+double decode_float(Oid type, std::string_view raw){
+  switch(type){
+    case FLOAT4OID: return std::bit_cast<float>(read_be<std::uint32_t>(raw.data()));
+    case FLOAT8OID: return std::bit_cast<double>(read_be<std::uint64_t>(raw.data()));
+    case NUMERICOID: return numeric_to_double(raw);
+    case INT2OID:
+    case INT4OID:
+    case INT8OID: return static_cast<double>(decode_int(type, raw));
+    default:
+      throw std::runtime_error(std::format("[ERROR: in 'binary::decode_float()'] => Column of type oid {} is not numeric.", type));
+  }
+}
+
+timestamp decode_timestamp(Oid type, std::string_view raw){
+  switch(type){
+    case TIMESTAMPOID:
+    case TIMESTAMPTZOID: return pg_epoch + std::chrono::microseconds{read_be<std::int64_t>(raw.data())};
+    case DATEOID: return pg_epoch + std::chrono::days{read_be<std::int32_t>(raw.data())};
+    default:
+      throw std::runtime_error(std::format("[ERROR: in 'binary::decode_timestamp()'] => Column of type oid {} is not a timestamp.", type));
+  }
+}
+
+std::string numeric_to_str(std::string_view raw){
+  std::int16_t ndigits = read_be<std::int16_t>(raw.data());
+  std::int16_t weight = read_be<std::int16_t>(raw.data() + 2);
+  std::uint16_t sign = read_be<std::uint16_t>(raw.data() + 4);
+  std::uint16_t dscale = read_be<std::uint16_t>(raw.data() + 6);
+  auto digit = [&](int i)-> int{
+    return (i >= 0 && i < ndigits) ? read_be<std::int16_t>(raw.data() + 8 + 2*i) : 0;
+  };
+
+  if(sign == 0xC000) return "NaN";
+  if(sign == 0xD000) return "Infinity";
+  if(sign == 0xF000) return "-Infinity";
+
+  std::string str = (sign == 0x4000) ? "-" : "";
+  if(weight < 0) str += "0";
+  for(int i = 0; i <= weight; ++i){
+    std::string group = std::to_string(digit(i));
+    if(i > 0) group.insert(0, 4 - group.size(), '0');
+    str += group;
+  }
+
+  if(dscale > 0){
+    std::string fraction {};
+    for(int i = weight + 1; fraction.size() < dscale; ++i){
+      std::string group = std::to_string(digit(i));
+      fraction += std::string(4 - group.size(), '0') + group;
+    }
+    str += "." + fraction.substr(0, dscale);
+  }
+  return str;
+}
+
+std::string time_of_day_str(std::chrono::microseconds since_midnight){
+  std::chrono::hh_mm_ss hms {since_midnight};
+  char buf[32];
+  int len = std::snprintf(buf, sizeof(buf), "%02d:%02d:%02d", static_cast<int>(hms.hours().count()),
+                          static_cast<int>(hms.minutes().count()), static_cast<int>(hms.seconds().count()));
+  std::string str(buf, len);
+  if(hms.subseconds().count() != 0){
+    len = std::snprintf(buf, sizeof(buf), ".%06lld", static_cast<long long>(hms.subseconds().count()));
+    str.append(buf, len);
+    while(str.back() == '0') str.pop_back();
+  }
+  return str;
+}
+
+std::string date_str(std::chrono::sys_days day){
+  std::chrono::year_month_day ymd {day};
+  char buf[16];
+  int len = std::snprintf(buf, sizeof(buf), "%04d-%02u-%02u", static_cast<int>(ymd.year()),
+                          static_cast<unsigned>(ymd.month()), static_cast<unsigned>(ymd.day()));
+  return std::string(buf, len);
+}
+
+std::string decode_text(Oid type, std::string_view raw){
+  if(is_textual(type)) return std::string(raw);
+
+  switch(type){
+    case BOOLOID: return raw[0] ? "t" : "f";
+    case INT2OID:
+    case INT4OID:
+    case INT8OID:
+    case OIDOID: return std::to_string(decode_int(type, raw));
+    case FLOAT4OID:
+    case FLOAT8OID: {
+      char buf[32];
+      auto [end, ec] = std::to_chars(buf, buf + sizeof(buf), decode_float(type, raw));
+      return std::string(buf, end);
+    }
+    case NUMERICOID: return numeric_to_str(raw);
+    case DATEOID: return date_str(std::chrono::floor<std::chrono::days>(decode_timestamp(type, raw)));
+    case TIMEOID: return time_of_day_str(std::chrono::microseconds{read_be<std::int64_t>(raw.data())});
+    case TIMESTAMPOID:
+    case TIMESTAMPTZOID: {
+      std::int64_t us = read_be<std::int64_t>(raw.data());
+      if(us == std::numeric_limits<std::int64_t>::max()) return "infinity";
+      if(us == std::numeric_limits<std::int64_t>::min()) return "-infinity";
+      timestamp ts = decode_timestamp(type, raw);
+      std::chrono::sys_days day = std::chrono::floor<std::chrono::days>(ts);
+      std::string str = date_str(day) + " " + time_of_day_str(ts - day);
+      return type == TIMESTAMPTZOID ? str + "+00" : str;
+    }
+    default:
+      throw std::runtime_error(std::format("[ERROR: in 'binary::decode_text()'] => Unsupported column type oid {}.", type));
+  }
+}
+}
+
+std::pair<std::chrono::sys_days, std::chrono::sys_days> partition_bounds(std::chrono::sys_days day, Interval interval){
+  using namespace std::chrono;
+  switch(interval){
+    case DAY: return {day, day + days{1}};
+    case WEEK:{
+      sys_days monday = day - (weekday{day} - Monday);
+      return {monday, monday + weeks{1}};
+    }
+    case MONTH:{
+      year_month_day ymd {day};
+      year_month first = ymd.year()/ymd.month();
+      return {sys_days{first/1}, sys_days{(first + months{1})/1}};
+    }
+    default:
+      throw std::runtime_error("[ERROR: in 'partition_bounds()'] => Unknown partition interval.");
+  }
+}
+
+std::string partition_name(const std::string& model_name, std::chrono::sys_days day, Interval interval){
+  std::string start = binary::date_str(partition_bounds(day, interval).first);
+  start.erase(std::remove(start.begin(), start.end(), '-'), start.end());
+  return model_name + "_p" + start;
+}
+
+void create_range_partition(const std::string& model_name, std::chrono::sys_days day, Interval interval, std::ofstream& Migrations){
+  auto [from, to] = partition_bounds(day, interval);
+  Migrations<< "CREATE TABLE IF NOT EXISTS " + partition_name(model_name, day, interval) + " PARTITION OF " + model_name
+            << " FOR VALUES FROM ('" + binary::date_str(from) + "') TO ('" + binary::date_str(to) + "');\n";
+}
+
+void create_partitions(const std::string& model_name, const Partition& partition, bool date_column, std::ofstream& Migrations){
+  if(partition.strategy == "HASH"){
+    if(partition.modulus <= 0) return;
+    for(int remainder = 0; remainder < partition.modulus; ++remainder){
+      Migrations<< "CREATE TABLE IF NOT EXISTS " + model_name + "_p" + std::to_string(remainder) + " PARTITION OF " + model_name
+                << " FOR VALUES WITH (MODULUS " + std::to_string(partition.modulus) + ", REMAINDER " + std::to_string(remainder) + ");\n";
+    }
+  }else if(partition.strategy == "RANGE" && date_column){
+    std::chrono::sys_days today = std::chrono::floor<std::chrono::days>(std::chrono::system_clock::now());
+    create_range_partition(model_name, today, MONTH, Migrations);
+    create_range_partition(model_name, partition_bounds(today, MONTH).second, MONTH, Migrations);
+  }else{
+    Migrations<< "CREATE TABLE IF NOT EXISTS " + model_name + "_default PARTITION OF " + model_name + " DEFAULT;\n";
+  }
+  Migrations<< "\n";
+}
+
+std::size_t maintain_partitions(const std::string& model_name, Interval interval, int premake, int retain){
+  using namespace std::chrono;
+  sys_days today = floor<days>(system_clock::now());
+  std::size_t dropped = 0;
+
+  try{
+    pqxx::connection cxn = connect(PRIMARY);
+    pqxx::nontransaction ntxn(cxn);
+
+    sys_days next = today;
+    for(int i = 0; i <= premake; ++i){
+      auto [from, to] = partition_bounds(next, interval);
+      ntxn.exec("CREATE TABLE IF NOT EXISTS " + partition_name(model_name, next, interval) + " PARTITION OF " + model_name +
+                " FOR VALUES FROM ('" + binary::date_str(from) + "') TO ('" + binary::date_str(to) + "')");
+      next = to;
+    }
+
+    sys_days cutoff = partition_bounds(today, interval).first;
+    for(int i = 0; i < retain; ++i) cutoff = partition_bounds(cutoff - days{1}, interval).first;
+
+    pqxx::result partitions = ntxn.exec("select c.relname from pg_inherits i join pg_class c on c.oid = i.inhrelid "
+                                        "join pg_class p on p.oid = i.inhparent where p.relname = $1", pqxx::params{model_name});
+    std::string prefix = model_name + "_p";
+    for(const pqxx::row& row : partitions){
+      std::string name = row[0].as<std::string>();
+      if(name.size() != prefix.size() + 8 || name.compare(0, prefix.size(), prefix) != 0) continue;
+
+      int y = 0;
+      unsigned m = 0, d = 0;
+      if(std::sscanf(name.c_str() + prefix.size(), "%4d%2u%2u", &y, &m, &d) != 3) continue;
+      year_month_day start {year{y}/month{m}/day{d}};
+      if(!start.ok() || partition_bounds(sys_days{start}, interval).second > cutoff) continue;
+
+      //DETACH ... CONCURRENTLY only takes a SHARE UPDATE EXCLUSIVE lock on the parent.
+      ntxn.exec("ALTER TABLE " + model_name + " DETACH PARTITION " + name + " CONCURRENTLY");
+      ntxn.exec("DROP TABLE IF EXISTS " + name);
+      ++dropped;
+    }
+  }catch(const std::exception& e){
+    throw std::runtime_error(std::format("[ERROR: in 'maintain_partitions()'] => {}", e.what()));
+  }
+  return dropped;
+}
+
+std::size_t backfill(const std::string& model_name, const std::string& column_name, const std::string& value_sql){
+  std::string id_col = model_name + "_id";
+  std::size_t updated = 0;
+
+  try{
+    pqxx::connection cxn = connect(PRIMARY);
+    {
+      pqxx::nontransaction ntxn(cxn);
+      ntxn.exec("create table if not exists strata_backfill_progress (table_name text not null, column_name text not null, "
+                "last_id bigint not null, updated_at timestamptz not null default now(), primary key (table_name, column_name))");
+    }
+
+    std::int64_t last_id = 0, max_id = 0;
+    {
+      pqxx::work txn(cxn);
+      pqxx::row bounds = txn.exec("select coalesce(min(" + id_col + "), 1) - 1, coalesce(max(" + id_col + "), 0) from " + model_name).one_row();
+      last_id = bounds[0].as<std::int64_t>();
+      max_id = bounds[1].as<std::int64_t>();
+
+      pqxx::result progress = txn.exec("select last_id from strata_backfill_progress where table_name = $1 and column_name = $2",
+                                       pqxx::params{model_name, column_name});
+      if(!progress.empty()){
+        last_id = std::max(last_id, progress[0][0].as<std::int64_t>());
+        std::cout<<"[backfill] Resuming "<<model_name<<"."<<column_name<<" after id "<<last_id<<std::endl;
+      }
+      txn.commit();
+    }
+
+    std::int64_t first_id = last_id;
+    while(last_id < max_id){
+      std::int64_t upper = std::min<std::int64_t>(last_id + static_cast<std::int64_t>(backfill_batch_size), max_id);
+      pqxx::work txn(cxn);
+      updated += txn.exec("update " + model_name + " set " + column_name + " = " + value_sql + " where " + id_col + " > $1 and " +
+                          id_col + " <= $2 and " + column_name + " is null", pqxx::params{last_id, upper}).affected_rows();
+      txn.exec("insert into strata_backfill_progress (table_name, column_name, last_id) values ($1, $2, $3) "
+               "on conflict (table_name, column_name) do update set last_id = excluded.last_id, updated_at = now()",
+               pqxx::params{model_name, column_name, upper});
+      txn.commit();
+      last_id = upper;
+
+      std::cout<<"[backfill] "<<model_name<<"."<<column_name<<": "<<(last_id - first_id)<<"/"<<(max_id - first_id)<<" ids, "
+               <<updated<<" rows updated"<<std::endl;
+      if(last_id < max_id) std::this_thread::sleep_for(backfill_pause);
+    }
+
+    pqxx::work txn(cxn);
+    txn.exec("delete from strata_backfill_progress where table_name = $1 and column_name = $2", pqxx::params{model_name, column_name});
+    txn.commit();
+  }catch(const std::exception& e){
+    throw std::runtime_error(std::format("[ERROR: in 'backfill()'] => {}", e.what()));
+  }
+  return updated;
+}
+
+//Splits on semicolons outside of quoted strings, E'' strings with backslash escapes, quoted identifiers,
+//$tag$ quoting, -- comments and nested /* */ comments.
+std::vector<std::string> split_sql(const std::string& raw_sql){
+  std::vector<std::string> statements {};
+  std::string current {};
+  std::size_t n = raw_sql.size();
+  auto is_word = [&](std::size_t at){
+    return std::isalnum(static_cast<unsigned char>(raw_sql[at])) || raw_sql[at] == '_';
+  };
+
+  for(std::size_t i = 0; i < n; ++i){
+    char ch = raw_sql[i];
+    char next = i + 1 < n ? raw_sql[i + 1] : '\0';
+    std::size_t end = i;
+
+    if(ch == '-' && next == '-'){
+      end = raw_sql.find('\n', i);
+      if(end == std::string::npos) end = n;
+    }else if(ch == '/' && next == '*'){
+      int depth = 0;
+      for(end = i; end < n; ++end){
+        if(raw_sql.compare(end, 2, "/*") == 0){ ++depth; ++end; }
+        else if(raw_sql.compare(end, 2, "*/") == 0 && --depth == 0){ end += 2; break; }
+      }
+      end = std::min(end, n);
+    }else if(ch == '\''){
+      bool escapes = i > 0 && (raw_sql[i - 1] == 'E' || raw_sql[i - 1] == 'e') && (i < 2 || !is_word(i - 2));
+      for(end = i + 1; end < n; ++end){
+        if(escapes && raw_sql[end] == '\\'){ ++end; continue; }
+        if(raw_sql[end] != '\'') continue;
+        if(end + 1 < n && raw_sql[end + 1] == '\''){ ++end; continue; }
+        break;
+      }
+      end = std::min(end + 1, n);
+    }else if(ch == '"'){
+      end = raw_sql.find('"', i + 1);
+      end = end == std::string::npos ? n : end + 1;
+    }else if(ch == '$' && (i == 0 || !is_word(i - 1))){
+      std::size_t tag_end = i + 1;
+      while(tag_end < n && is_word(tag_end)) ++tag_end;
+      bool is_tag = tag_end < n && raw_sql[tag_end] == '$' &&
+                    (tag_end == i + 1 || !std::isdigit(static_cast<unsigned char>(raw_sql[i + 1])));
+      if(is_tag){
+        std::string delimiter = raw_sql.substr(i, tag_end - i + 1);
+        end = raw_sql.find(delimiter, tag_end + 1);
+        end = end == std::string::npos ? n : end + delimiter.size();
+      }
+    }else if(ch == ';'){
+      statements.push_back(current);
+      current.clear();
+      continue;
+    }
+
+    if(end > i){
+      current.append(raw_sql, i, end - i);
+      i = end - 1;
+      continue;
+    }
+    current += ch;
+  }
+  statements.push_back(current);
+
+  std::vector<std::string> trimmed {};
+  for(std::string& statement : statements){
+    std::size_t begin = statement.find_first_not_of(" \t\r\n");
+    if(begin == std::string::npos) continue;
+    std::size_t end = statement.find_last_not_of(" \t\r\n");
+    trimmed.push_back(statement.substr(begin, end - begin + 1));
+  }
+  return trimmed;
+}
+
+std::vector<MigrationStep> migration_steps(const std::string& raw_sql){
+  std::vector<MigrationStep> steps {};
+  std::optional<MigrationStep> group {};
+
+  auto push = [&](MigrationStep step){
+    if(!group){
+      steps.push_back(std::move(step));
+      return;
+    }
+    if(step.kind != TRANSACTIONAL)
+      throw std::runtime_error(std::format("[ERROR: in 'migration_steps()'] => '{}' can't run inside a transaction group.", step.sql));
+    group->sql += (group->sql.empty() ? "" : ";\n") + step.sql;
+  };
+
+  for(std::string& statement : split_sql(raw_sql)){
+    while(statement.starts_with("--")){
+      std::size_t eol = statement.find('\n');
+      std::string comment = statement.substr(0, eol);
+      statement = eol == std::string::npos ? "" : statement.substr(eol + 1);
+
+      if(comment.starts_with(begin_directive)){
+        if(group) throw std::runtime_error("[ERROR: in 'migration_steps()'] => Nested transaction groups are not supported.");
+        group.emplace(MigrationStep{TRANSACTIONAL});
+      }else if(comment.starts_with(commit_directive)){
+        if(!group) throw std::runtime_error("[ERROR: in 'migration_steps()'] => Commit directive without a matching begin.");
+        MigrationStep closed = std::move(*group);
+        group.reset();
+        if(!closed.sql.empty()) steps.push_back(std::move(closed));
+      }else if(comment.starts_with(backfill_directive)){
+        MigrationStep step {BACKFILL, comment};
+        std::istringstream directive(comment.substr(backfill_directive.size()));
+        directive >> step.table >> step.column;
+        std::getline(directive >> std::ws, step.value);
+        push(std::move(step));
+      }
+    }
+    if(statement.empty()) continue;
+
+    std::string upper = statement;
+    bool concurrently = str_to_upper(upper).find("CONCURRENTLY") != std::string::npos;
+    push(MigrationStep{concurrently ? NON_TRANSACTIONAL : TRANSACTIONAL, statement});
+  }
+  if(group) throw std::runtime_error("[ERROR: in 'migration_steps()'] => Transaction group is missing its commit directive.");
+  return steps;
+}
+
+//Name of the index a CREATE INDEX CONCURRENTLY statement builds, as pg_class stores it, or empty for any other statement.
+std::string concurrent_index_name(const std::string& statement){
+  std::istringstream words(statement);
+  std::vector<std::string> upper {}, original {};
+  for(std::string word; upper.size() < 8 && words >> word;){
+    original.push_back(word);
+    upper.push_back(str_to_upper(word));
+  }
+
+  std::size_t at = 0;
+  auto next_is = [&](const std::string& keyword){
+    if(at < upper.size() && upper[at] == keyword){
+      ++at;
+      return true;
+    }
+    return false;
+  };
+  if(!next_is("CREATE")) return "";
+  next_is("UNIQUE");
+  if(!next_is("INDEX") || !next_is("CONCURRENTLY")) return "";
+  if(next_is("IF") && !(next_is("NOT") && next_is("EXISTS"))) return "";
+  if(at >= upper.size() || upper[at] == "ON") return "";
+
+  //Unquoted identifiers are folded to lower case.
+  std::string name = original[at];
+  if(name.starts_with('"')) return name.substr(1, name.size() - 2);
+  std::transform(name.begin(), name.end(), name.begin(), [](unsigned char ch){ return std::tolower(ch); });
+  return name;
+}
+
 std::optional<pqxx::result> execute_sql(std::string& sql_file_or_str, bool is_file_name){
   std::ostringstream raw_sql {};
 
@@ -219,20 +1336,35 @@ std::optional<pqxx::result> execute_sql(std::string& sql_file_or_str, bool is_fi
     raw_sql << sql_file_or_str;
   }
 
-  Utils::db_params params = Utils::parse_db_conn_params();
-
   try{
-    pqxx::connection cxn("dbname=" + params.db_name+
-                         " user=" + params.user +
-                         " password=" + params.passwd +
-                         " host=" + params.host +
-                         " port=" + std::to_string(params.port)
-                         );
-    pqxx::work txn(cxn);
+    pqxx::connection cxn = connect(PRIMARY);
+    pqxx::result results {};
+    std::string transactional {};
 
-    pqxx::result results = txn.exec(raw_sql.str());
+    auto commit_pending = [&](){
+      if(transactional.empty()) return;
+      pqxx::work txn(cxn);
+      results = txn.exec(transactional);
+      txn.commit();
+      transactional.clear();
+    };
 
-    txn.commit();
+    //Consecutive transactional statements share one transaction; other steps commit what came before them and run on their own.
+    for(const MigrationStep& step : migration_steps(raw_sql.str())){
+      if(step.kind == TRANSACTIONAL){
+        transactional += step.sql + ";\n";
+        continue;
+      }
+      commit_pending();
+      if(step.kind == BACKFILL){
+        backfill(step.table, step.column, step.value);
+      }else{
+        pqxx::nontransaction ntxn(cxn);
+        ntxn.exec(step.sql);
+      }
+    }
+    commit_pending();
+    Session::current().record_write(cxn);
 
     if(!results.empty()) return results;
     return std::nullopt;
@@ -241,4 +1373,95 @@ std::optional<pqxx::result> execute_sql(std::string& sql_file_or_str, bool is_fi
   }
 }
 
+std::size_t run_migrations(const std::string& sql_filename){
+  std::ifstream sql_file(sql_filename);
+  if(!sql_file.is_open())
+    throw std::runtime_error(std::format("[ERROR: in 'run_migrations()'] => Couldn't open the migrations file '{}'.", sql_filename));
+  std::ostringstream raw_sql {};
+  raw_sql << sql_file.rdbuf();
+
+  std::string file_hash = std::format("{:016x}", Utils::fnv1a(raw_sql.str()));
+  std::vector<MigrationStep> steps = migration_steps(raw_sql.str());
+  std::size_t applied = 0;
+  int position = 1;
+
+  try{
+    pqxx::connection cxn = connect(PRIMARY);
+    std::unordered_set<int> done {};
+    {
+      pqxx::nontransaction ntxn(cxn);
+      ntxn.exec("create table if not exists strata_migrations (file_hash text not null, position integer not null, "
+                "statement text not null, duration_ms double precision not null, attempts integer not null, "
+                "applied_at timestamptz not null default now(), primary key (file_hash, position))");
+      for(const pqxx::row& row : ntxn.exec("select position from strata_migrations where file_hash = $1", pqxx::params{file_hash}))
+        done.insert(row[0].as<int>());
+    }
+
+    for(; position <= static_cast<int>(steps.size()); ++position){
+      if(done.contains(position)) continue;
+      const MigrationStep& step = steps[position - 1];
+
+      auto record = [&](pqxx::transaction_base& txn, double duration_ms, int attempts){
+        txn.exec("insert into strata_migrations (file_hash, position, statement, duration_ms, attempts) values ($1, $2, $3, $4, $5)",
+                 pqxx::params{file_hash, position, step.sql, duration_ms, attempts});
+      };
+
+      //Only transactional steps, including begin/commit groups as a whole, wait under lock_timeout. A CONCURRENTLY build takes
+      //no lock that blocks reads or writes while it waits.
+      double duration_ms = 0;
+      std::chrono::milliseconds backoff = migration_retry_backoff;
+      for(int attempt = 1;; ++attempt){
+        try{
+          auto start = std::chrono::steady_clock::now();
+          auto elapsed_ms = [&](){ return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(); };
+
+          if(step.kind == TRANSACTIONAL){
+            pqxx::work txn(cxn);
+            txn.exec("set local lock_timeout = " + std::to_string(migration_lock_timeout.count()));
+            txn.exec(step.sql);
+            duration_ms = elapsed_ms();
+            record(txn, duration_ms, attempt);
+            txn.commit();
+          }else{
+            if(step.kind == BACKFILL){
+              backfill(step.table, step.column, step.value);
+            }else{
+              pqxx::nontransaction ntxn(cxn);
+              //A concurrent build that failed part-way leaves an INVALID index, which IF NOT EXISTS would then accept as done.
+              if(std::string index = concurrent_index_name(step.sql); !index.empty()){
+                pqxx::result validity = ntxn.exec("select i.indisvalid from pg_index i join pg_class c on c.oid = i.indexrelid "
+                                                  "where c.relname = $1 and pg_table_is_visible(c.oid)", pqxx::params{index});
+                if(!validity.empty() && !validity[0][0].as<bool>()){
+                  std::cout<<"[migrate] Dropping invalid index "<<index<<" left by an earlier attempt"<<std::endl;
+                  ntxn.exec("DROP INDEX CONCURRENTLY IF EXISTS " + ntxn.quote_name(index));
+                }
+              }
+              ntxn.exec(step.sql);
+            }
+            duration_ms = elapsed_ms();
+            pqxx::work txn(cxn);
+            record(txn, duration_ms, attempt);
+            txn.commit();
+          }
+          break;
+        }catch(const pqxx::sql_error& e){
+          //55P03 is lock_not_available, raised when lock_timeout expires.
+          if(e.sqlstate() != "55P03" || attempt > migration_retries) throw;
+          std::cout<<"[migrate] Step "<<position<<" timed out waiting for locks, retrying in "<<backoff.count()<<" ms"<<std::endl;
+          std::this_thread::sleep_for(backoff);
+          backoff *= 2;
+        }
+      }
+
+      ++applied;
+      std::string summary = step.sql.substr(0, step.sql.find('\n'));
+      std::cout<<std::format("[migrate] {}/{} {:.1f} ms: {}", position, steps.size(), duration_ms, summary)<<std::endl;
+    }
+    if(applied) Session::current().record_write(cxn);
+  }catch(const std::exception& e){
+    throw std::runtime_error(std::format("[ERROR: in 'run_migrations()'] => Step {} of {} failed. {}", position, steps.size(), e.what()));
+  }
+  return applied;
+}
+
 }
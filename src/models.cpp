@@ -1,10 +1,15 @@
+#include <algorithm>
+#include <cctype>
 #include <iostream>
 #include <memory>
 #include <stdexcept>
 #include <string>
 #include <variant>
 #include <vector>
+#include <filesystem>
 #include <fstream>
+#include <map>
+#include <set>
 #include "../strata/models.hpp"
 #include "../strata/db_adapters.hpp"
 
@@ -36,6 +41,7 @@ ms_map parse_to_obj(nlohmann::json& j){
   DataTypeVariant variant;
 
   for(const auto& [model, j_field_map] : j.items()){
+    if(model == "__meta__" || model == "__hash__") continue;
     for(const auto& [col, json_dtv] : j_field_map.items()){
       variant_from_json(json_dtv, variant);
       fields[col] = variant;
@@ -47,30 +53,149 @@ ms_map parse_to_obj(nlohmann::json& j){
   return parsed;
 }
 
-void save_schema_ms(const ms_map& schema){
+//Model-level settings live under "__meta__" so older schema files without it still load.
+nlohmann::json jsonify_meta(const meta_map& meta){
+  nlohmann::json j = nlohmann::json::object();
+  for(const auto& [mn, model_meta] : meta){
+    nlohmann::json indexes = nlohmann::json::array();
+    for(const Index& index : model_meta.indexes){
+      indexes.push_back({
+        {"columns", index.columns},
+        {"method", index.method},
+        {"where", index.where},
+        {"unique", index.unique},
+        {"name", index.name}
+      });
+    }
+    nlohmann::json partition = {
+      {"strategy", model_meta.partition.strategy},
+      {"column", model_meta.partition.column},
+      {"modulus", model_meta.partition.modulus}
+    };
+    j[mn] = {{"shard_key", model_meta.shard_key}, {"indexes", indexes}, {"partition", partition}};
+  }
+  return j;
+}
+
+meta_map parse_meta(const nlohmann::json& j){
+  meta_map parsed;
+  auto meta_it = j.find("__meta__");
+  if(meta_it == j.end()) return parsed;
+
+  for(const auto& [model, j_meta] : meta_it->items()){
+    ModelMeta model_meta {j_meta.value("shard_key", "")};
+    for(const auto& j_index : j_meta.value("indexes", nlohmann::json::array())){
+      model_meta.indexes.push_back(Index{
+        j_index.at("columns").get<std::vector<std::string>>(),
+        j_index.value("method", "btree"),
+        j_index.value("where", ""),
+        j_index.value("unique", false),
+        j_index.value("name", "")
+      });
+    }
+    nlohmann::json j_partition = j_meta.value("partition", nlohmann::json::object());
+    model_meta.partition = Partition{
+      j_partition.value("strategy", ""),
+      j_partition.value("column", ""),
+      j_partition.value("modulus", 0)
+    };
+    parsed[model] = model_meta;
+  }
+  return parsed;
+}
+
+//json objects keep their keys sorted, so the dump and its hash don't depend on registration order.
+std::string schema_hash(const ms_map& schema, const meta_map& meta){
+  nlohmann::json j = jsonify(schema);
+  j["__meta__"] = jsonify_meta(meta);
+  return std::format("{:016x}", Utils::fnv1a(j.dump()));
+}
+
+void save_schema_ms(const ms_map& schema, const meta_map& meta, const std::string& hash){
   std::ofstream schema_ms_file("schema.json");
   if(!schema_ms_file.is_open()) throw std::runtime_error("[ERROR: from 'save_schema_ms()'] => Could not write schema into file.");
-  schema_ms_file << jsonify(schema).dump(2);
+  nlohmann::json j = jsonify(schema);
+  j["__meta__"] = jsonify_meta(meta);
+  j["__hash__"] = hash;
+  schema_ms_file << j.dump(2);
 }
 
-ms_map load_schema_ms(){
+nlohmann::json load_schema_json(){
+  if(!std::filesystem::exists("schema.json") || std::filesystem::file_size("schema.json") == 0) return nlohmann::json::object();
   std::ifstream schema_ms_file("schema.json");
-  if(!schema_ms_file.is_open()) throw std::runtime_error("[ERROR: from 'load_schema_ms()'] => Could not load schema from file.");
+  if(!schema_ms_file.is_open()) throw std::runtime_error("[ERROR: from 'load_schema_json()'] => Could not load schema from file.");
   nlohmann::json j;
   schema_ms_file >> j;
-  return parse_to_obj(j);
+  return j;
 }
 
 void Model::make_migrations(const nlohmann::json& mrm, const nlohmann::json& frm, std::string sql_filename){
   for(const auto& pair : ModelFactory::registry()){
-    new_ms[pair.first] = ModelFactory::create_model_instance(pair.first)->col_map;
+    std::unique_ptr<Model> model = ModelFactory::create_model_instance(pair.first);
+    if(!model->shard_key.empty() && model->col_map.find(model->shard_key) == model->col_map.end()){
+      throw std::runtime_error(std::format("[ERROR: in 'make_migrations()'] => Shard key '{}' is not a column of model '{}'.",
+                                           model->shard_key, pair.first));
+    }
+    new_ms[pair.first] = model->col_map;
+    Partition& partition = model->partition;
+    if(!partition.strategy.empty()){
+      std::transform(partition.strategy.begin(), partition.strategy.end(), partition.strategy.begin(), ::toupper);
+      if(partition.strategy != "RANGE" && partition.strategy != "LIST" && partition.strategy != "HASH")
+        throw std::runtime_error(std::format("[ERROR: in 'make_migrations()'] => Unknown partition strategy '{}' on model '{}'.",
+                                             partition.strategy, pair.first));
+      if(model->col_map.find(partition.column) == model->col_map.end())
+        throw std::runtime_error(std::format("[ERROR: in 'make_migrations()'] => Partition column '{}' is not a column of model '{}'.",
+                                             partition.column, pair.first));
+    }
+    new_meta[pair.first] = ModelMeta{model->shard_key, model->indexes, partition, model->expand_contract};
+  }
+
+  //A partitioned table's primary key and unique constraints all include the partition column, so a single-column
+  //reference only has a matching unique constraint when it points at the partition column itself.
+  for(const auto& [model_name, field_map] : new_ms){
+    for(const auto& [col, dtv_obj] : field_map){
+      const auto* fk = std::get_if<std::shared_ptr<ForeignKey>>(&dtv_obj);
+      if(!fk) continue;
+      auto ref_meta = new_meta.find((*fk)->model_name);
+      if(ref_meta == new_meta.end() || ref_meta->second.partition.strategy.empty()) continue;
+
+      const Partition& partition = ref_meta->second.partition;
+      const fields& ref_fields = new_ms.at((*fk)->model_name);
+      auto ref_col = ref_fields.find((*fk)->ref_col_name);
+      bool unique_partition_col = (*fk)->ref_col_name == partition.column && ref_col != ref_fields.end() &&
+                                  std::visit([](const auto& col_obj){ return col_obj->unique; }, ref_col->second);
+      if(!unique_partition_col)
+        throw std::runtime_error(std::format("[ERROR: in 'make_migrations()'] => Foreign key '{}.{}' references '{}.{}', but '{}' is "
+                                             "partitioned by '{}' and has no unique constraint on that column alone.",
+                                             model_name, col, (*fk)->model_name, (*fk)->ref_col_name, (*fk)->model_name,
+                                             partition.column));
+    }
+  }
+
+  std::string hash = schema_hash(new_ms, new_meta);
+  nlohmann::json stored = load_schema_json();
+  if(stored.value("__hash__", "") == hash){
+    //Nothing changed: leave an empty migrations file so a later execute_sql() is a no-op.
+    std::ofstream Migrations (sql_filename);
+    db_adapter::create_models_hpp(new_ms, new_meta);
+    return;
   }
-  if(std::filesystem::exists("schema.json") && std::filesystem::file_size("schema.json") > 0){
-    init_ms = load_schema_ms();
+  if(!stored.empty()){
+    init_meta = parse_meta(stored);
+    init_ms = parse_to_obj(stored);
   }
-  save_schema_ms(new_ms);
-  track_changes(mrm, frm, sql_filename);
-  db_adapter::create_models_hpp(new_ms);
+  //The diff is written next to the target and only replaces it, and schema.json, once it is complete, so a
+  //refused change is diffed again on the next run instead of being hidden behind a matching hash.
+  std::string pending_filename = sql_filename + ".pending";
+  try{
+    track_changes(mrm, frm, pending_filename);
+  }catch(...){
+    std::filesystem::remove(pending_filename);
+    throw;
+  }
+  std::filesystem::rename(pending_filename, sql_filename);
+  save_schema_ms(new_ms, new_meta, hash);
+  db_adapter::create_models_hpp(new_ms, new_meta);
 }
 
 void rename(const nlohmann::json& mrm, const nlohmann::json& frm, ms_map& init_ms, std::ofstream& Migrations){
@@ -108,7 +233,7 @@ void rename(const nlohmann::json& mrm, const nlohmann::json& frm, ms_map& init_m
   }
 }
 
-void create_or_drop_tables(ms_map& init_ms, ms_map& new_ms, std::ofstream& Migrations){
+void create_or_drop_tables(ms_map& init_ms, ms_map& new_ms, const meta_map& new_meta, std::ofstream& Migrations){
   char choice = 'n';
 
   for(auto it = init_ms.begin(); it != init_ms.end();){
@@ -129,7 +254,8 @@ void create_or_drop_tables(ms_map& init_ms, ms_map& new_ms, std::ofstream& Migra
   for(auto it = new_ms.begin(); it != new_ms.end();){
     const auto& [model, field_map] = *it;
     if(init_ms.find(model) == init_ms.end()){
-      db_adapter::create_table(model, field_map, Migrations);
+      auto meta_it = new_meta.find(model);
+      db_adapter::create_table(model, field_map, Migrations, meta_it == new_meta.end() ? Partition{} : meta_it->second.partition);
       it = new_ms.erase(it);
       continue;
     }
@@ -137,21 +263,50 @@ void create_or_drop_tables(ms_map& init_ms, ms_map& new_ms, std::ofstream& Migra
   }
 }
 
-void handle_types(ms_map::iterator& new_it, const std::string col, DataTypeVariant& dtv_obj, const nlohmann::json& mrm,
-                  const nlohmann::json& frm, DataTypeVariant& init_dtv, std::ofstream& Migrations){
+//Value written into existing NULLs when a column becomes NOT NULL. Only a declared default is used; without one
+//the column is left as is and the migration's VALIDATE step fails if it still holds NULLs.
+std::string fill_value(const DataTypeVariant& dtv_obj){
+  return std::visit(overloaded{
+    [](const std::shared_ptr<BoolField>& col_obj) -> std::string {
+      if(!col_obj->enable_default) return "";
+      return col_obj->default_value ? "TRUE" : "FALSE";
+    },
+    [](const std::shared_ptr<DateTimeField>& col_obj) -> std::string {
+      return col_obj->enable_default ? col_obj->default_val : "";
+    },
+    [](const auto&) -> std::string { return ""; }
+  }, dtv_obj);
+}
+
+//Returns true when the column is rebuilt through expand/contract, which then also owns its NOT NULL.
+bool handle_types(ms_map::iterator& new_it, const std::string col, DataTypeVariant& dtv_obj, const nlohmann::json& mrm,
+                  const nlohmann::json& frm, DataTypeVariant& init_dtv, db_adapter::AlterBatch& batch, const ModelMeta& meta){
   std::string alterations;
+  bool expanded = false;
+
+  auto change_type = [&](const std::string& from_sql, const std::string& to_sql, const FieldAttr& field, const std::string& default_sql = ""){
+    db_adapter::AlterCost cost = db_adapter::type_change_cost(from_sql, to_sql);
+    if(cost == db_adapter::REWRITE && meta.expand_contract){
+      db_adapter::expand_contract_column(new_it->first, col, to_sql, field, default_sql, fill_value(dtv_obj),
+                                         db_adapter::table_indexes(new_it->first, new_it->second, meta),
+                                         !meta.partition.strategy.empty(), batch);
+      expanded = true;
+    }else{
+      db_adapter::alter_column_type(new_it->first, col, to_sql, batch, cost);
+    }
+  };
 
   auto visitor = overloaded{
     [&](std::shared_ptr<DateTimeField>& col_obj){
       std::visit(overloaded{
         [&](std::shared_ptr<DateTimeField>& init_field){
           if(init_field->datatype != col_obj->datatype){
-            db_adapter::alter_column_type(new_it->first, col, col_obj->datatype, Migrations);
+            change_type(init_field->datatype, col_obj->datatype, *col_obj, col_obj->enable_default ? col_obj->default_val : "");
           }
           if((init_field->enable_default != col_obj->enable_default) && col_obj->enable_default){
-            db_adapter::alter_column_defaultval(new_it->first, col, true, col_obj->default_val, Migrations);
+            db_adapter::alter_column_defaultval(new_it->first, col, true, col_obj->default_val, batch);
           }else{
-            db_adapter::alter_column_defaultval(new_it->first, col, false, col_obj->default_val, Migrations);
+            db_adapter::alter_column_defaultval(new_it->first, col, false, col_obj->default_val, batch);
           }
           return;
         },
@@ -167,7 +322,7 @@ void handle_types(ms_map::iterator& new_it, const std::string col, DataTypeVaria
       std::visit(overloaded{
         [&](std::shared_ptr<IntegerField>& init_field){
           if(init_field->datatype != col_obj->datatype){
-            db_adapter::alter_column_type(new_it->first, col, col_obj->datatype, Migrations);
+            change_type(init_field->datatype, col_obj->datatype, *col_obj);
           }
         /*if((init_field.check_condition != col_obj.check_condition) && col_obj.check_condition != "default"){
             string check = "CHECK(" + col + col_obj.check_condition + std::to_string(col_obj.check_constraint) + ")";
@@ -198,9 +353,8 @@ void handle_types(ms_map::iterator& new_it, const std::string col, DataTypeVaria
           constraint_name = constraint_name + "_" + col;
         }
       }
-      db_adapter::drop_constraint(new_it->first, constraint_name, Migrations);
-      Migrations<<"ALTER TABLE " + new_it->first + " ADD ";
-      db_adapter::create_fk_constraint(new_it->first, col_obj->sql_segment, col, Migrations);
+      db_adapter::drop_constraint(new_it->first, constraint_name, batch);
+      db_adapter::create_fk_constraint(new_it->first, col_obj->sql_segment, col, batch);
       return;
     },
     [&](std::shared_ptr<DecimalField>& col_obj){
@@ -211,7 +365,8 @@ void handle_types(ms_map::iterator& new_it, const std::string col, DataTypeVaria
              init_field->decimal_places != col_obj->decimal_places){
 
             alterations = col_obj->datatype + " (" + std::to_string(col_obj->max_length) + "," + std::to_string(col_obj->decimal_places) + ")";
-            db_adapter::alter_column_type(new_it->first, col, alterations, Migrations);
+            change_type(init_field->datatype + " (" + std::to_string(init_field->max_length) + "," + std::to_string(init_field->decimal_places) + ")",
+                        alterations, *col_obj);
           }
           return;
         },
@@ -228,7 +383,8 @@ void handle_types(ms_map::iterator& new_it, const std::string col, DataTypeVaria
         [&](std::shared_ptr<CharField>& init_field){
           if((init_field->datatype != col_obj->datatype) || (init_field->length != col_obj->length)){
             alterations = "VARCHAR( " + std::to_string(col_obj->length) + " )";
-            db_adapter::alter_column_type(new_it->first, col, alterations, Migrations);
+            change_type(init_field->datatype == "TEXT" ? init_field->datatype : init_field->datatype + "(" + std::to_string(init_field->length) + ")",
+                        alterations, *col_obj);
           }
           return;
         },
@@ -258,10 +414,10 @@ void handle_types(ms_map::iterator& new_it, const std::string col, DataTypeVaria
         [&](std::shared_ptr<BoolField>& init_field){
           if(init_field->enable_default != col_obj->enable_default){
             if(col_obj->enable_default){
-              db_adapter::alter_column_defaultval(new_it->first, col, true, std::to_string(col_obj->default_value), Migrations);
+              db_adapter::alter_column_defaultval(new_it->first, col, true, std::to_string(col_obj->default_value), batch);
             }else{
               alterations = col + " DROP DEFAULT";
-              db_adapter::alter_column_defaultval(new_it->first, col, false, "false", Migrations);
+              db_adapter::alter_column_defaultval(new_it->first, col, false, "false", batch);
             }
           }
           return;
@@ -276,6 +432,7 @@ void handle_types(ms_map::iterator& new_it, const std::string col, DataTypeVaria
     }
   };
   std::visit(visitor, dtv_obj);
+  return expanded;
 }
 
 std::string find_uq_constraint(const nlohmann::json& frm, const std::string& new_model_name, const std::string& new_col){
@@ -295,19 +452,118 @@ std::string find_uq_constraint(const nlohmann::json& frm, const std::string& new
   return constraint_name;
 }
 
+//Maps every identifier in text through renames, so index columns and predicates follow renamed columns.
+std::string rename_words(const std::string& text, const std::map<std::string, std::string>& renames){
+  std::string out {};
+  for(std::size_t i = 0; i < text.size();){
+    auto is_word = [&](std::size_t at){ return std::isalnum(static_cast<unsigned char>(text[at])) || text[at] == '_'; };
+    if(!is_word(i)){
+      out += text[i++];
+      continue;
+    }
+    std::size_t end = i;
+    while(end < text.size() && is_word(end)) ++end;
+    std::string word = text.substr(i, end - i);
+    auto it = renames.find(word);
+    out += it == renames.end() ? word : it->second;
+    i = end;
+  }
+  return out;
+}
+
+//Indexes on tables that already exist are built and dropped concurrently so writes keep flowing;
+//indexes on tables created in this migration are built inline since those tables are empty.
+//The existing indexes are taken from the schema as it was before mrm/frm renames, so an index whose name was
+//derived from a renamed table or column is renamed rather than silently kept under its old name.
+void diff_indexes(const ms_map& init_ms, const meta_map& init_meta, const nlohmann::json& mrm, const nlohmann::json& frm,
+                  const ms_map& target_ms, const meta_map& new_meta, std::ofstream& Migrations){
+  const ModelMeta no_meta {};
+
+  for(const auto& [model_name, field_map] : target_ms){
+    auto new_meta_it = new_meta.find(model_name);
+    std::map<std::string, Index> wanted = db_adapter::table_indexes(model_name, field_map,
+                                                                    new_meta_it == new_meta.end() ? no_meta : new_meta_it->second);
+    std::string old_model_name = model_name;
+    for(const auto& [old_mn, new_mn] : mrm.items()){
+      if(new_mn.get<std::string>() == model_name) old_model_name = old_mn;
+    }
+    std::map<std::string, std::string> column_renames {};
+    if(auto frm_it = frm.find(model_name); frm_it != frm.end()){
+      for(const auto& [old_cn, new_cn] : frm_it->items()) column_renames[old_cn] = new_cn.get<std::string>();
+    }
+
+    auto init_it = init_ms.find(old_model_name);
+    if(init_it == init_ms.end()){
+      for(const auto& [name, index] : wanted) db_adapter::create_index(model_name, index, false, Migrations);
+      continue;
+    }
+
+    //CREATE INDEX CONCURRENTLY is not supported on partitioned parents.
+    bool concurrently = new_meta_it == new_meta.end() || new_meta_it->second.partition.strategy.empty();
+    auto init_meta_it = init_meta.find(old_model_name);
+    std::map<std::string, Index> existing = db_adapter::table_indexes(old_model_name, init_it->second,
+                                                                      init_meta_it == init_meta.end() ? no_meta : init_meta_it->second);
+    std::set<std::string> kept {};
+    for(const auto& [name, index] : existing){
+      Index renamed = index;
+      renamed.name.clear();
+      bool derived = db_adapter::index_name(old_model_name, renamed) == name;
+      for(std::string& column : renamed.columns) column = rename_words(column, column_renames);
+      renamed.where = rename_words(renamed.where, column_renames);
+      renamed.name = derived ? db_adapter::index_name(model_name, renamed) : name;
+
+      auto wanted_it = wanted.find(renamed.name);
+      if(wanted_it == wanted.end() || !(wanted_it->second == renamed)){
+        db_adapter::drop_index(name, concurrently, Migrations);
+        continue;
+      }
+      if(renamed.name != name) Migrations<< "ALTER INDEX IF EXISTS " + name + " RENAME TO " + renamed.name + ";\n";
+      kept.insert(renamed.name);
+    }
+    for(const auto& [name, index] : wanted){
+      if(!kept.contains(name)) db_adapter::create_index(model_name, index, concurrently, Migrations);
+    }
+  }
+}
+
 void Model::track_changes(const nlohmann::json& mrm, const nlohmann::json& frm, std::string sql_filename){
 
   std::ofstream Migrations (sql_filename);
+  if(!Migrations.is_open())
+    throw std::runtime_error(std::format("[ERROR: in 'track_changes()'] => Could not open '{}'.", sql_filename));
+  auto finish = [&]{
+    Migrations.close();
+    if(Migrations.fail()) throw std::runtime_error(std::format("[ERROR: in 'track_changes()'] => Could not write '{}'.", sql_filename));
+  };
 
   if(init_ms.empty()){
     for(auto& [model_name, field_map] : new_ms){
-      db_adapter::create_table(model_name, field_map, Migrations);
+      db_adapter::create_table(model_name, field_map, Migrations, new_meta[model_name].partition);
     }
+    diff_indexes(init_ms, init_meta, mrm, frm, new_ms, new_meta, Migrations);
+    finish();
     return;
   }
 
+  const ms_map original_ms = init_ms;
+  const meta_map original_meta = init_meta;
   rename(mrm, frm, init_ms, Migrations);
-  create_or_drop_tables(init_ms, new_ms, Migrations);
+  for(const auto& [old_mn, new_mn] : mrm.items()){
+    auto meta_it = init_meta.find(old_mn);
+    if(meta_it == init_meta.end()) continue;
+    init_meta[new_mn.get<std::string>()] = meta_it->second;
+    init_meta.erase(old_mn);
+  }
+  for(const auto& [model_name, model_meta] : init_meta){
+    if(init_ms.find(model_name) == init_ms.end() || new_ms.find(model_name) == new_ms.end()) continue;
+    if(!(model_meta.partition == new_meta[model_name].partition))
+      throw std::runtime_error(std::format("[ERROR: in 'track_changes()'] => Changing the partitioning of existing table '{}' is not supported; "
+                                           "create a new partitioned table and copy the rows into it.", model_name));
+  }
+
+  const ms_map target_ms = new_ms;
+  create_or_drop_tables(init_ms, new_ms, new_meta, Migrations);
+  db_adapter::AlterBatch batch {};
 
   std::vector<std::string> pk_cols, uq_cols;
   std::string alterations, pk, fk;
@@ -320,22 +576,22 @@ void Model::track_changes(const nlohmann::json& mrm, const nlohmann::json& frm,
     for(auto& [new_col, dtv_obj] : new_it->second){
       std::visit([&](auto& col_obj){
         if(init_col_map.find(new_col) == init_col_map.end()){
-          db_adapter::alter_add_column(new_it->first, new_col, col_obj->sql_segment, Migrations);
+          db_adapter::alter_add_column(new_it->first, new_col, col_obj->sql_segment, batch);
           return;
         }
         std::visit([&](auto& init_field){
           if(init_field->sql_segment != col_obj->sql_segment){
-            handle_types(new_it, new_col, dtv_obj, mrm, frm, init_col_map[new_col], Migrations);
+            bool expanded = handle_types(new_it, new_col, dtv_obj, mrm, frm, init_col_map[new_col], batch, new_meta[new_it->first]);
 
             if(col_obj->primary_key){
               pk_cols.push_back(new_col);
             }
 
-            if(init_field->not_null != col_obj->not_null){
+            if(init_field->not_null != col_obj->not_null && !expanded){
               if(col_obj->not_null){
-                db_adapter::alter_column_nullable(new_it->first, new_col, false, Migrations);
+                db_adapter::alter_column_nullable(new_it->first, new_col, false, batch, fill_value(dtv_obj));
               }else{
-                db_adapter::alter_column_nullable(new_it->first, new_col, true, Migrations);
+                db_adapter::alter_column_nullable(new_it->first, new_col, true, batch);
               }
             }
 
@@ -347,9 +603,9 @@ void Model::track_changes(const nlohmann::json& mrm, const nlohmann::json& frm,
               }
             }else if((init_field->unique != col_obj->unique) && !col_obj->unique){
               if(frm.empty()){
-                db_adapter::drop_constraint(new_it->first, "uq_"+new_col , Migrations);
+                db_adapter::drop_constraint(new_it->first, "uq_"+new_col , batch);
               }else{
-                db_adapter::drop_constraint(new_it->first, "uq_"+find_uq_constraint(frm,new_it->first,new_col), Migrations);
+                db_adapter::drop_constraint(new_it->first, "uq_"+find_uq_constraint(frm,new_it->first,new_col), batch);
               }
             }else {
               return;
@@ -359,8 +615,7 @@ void Model::track_changes(const nlohmann::json& mrm, const nlohmann::json& frm,
       }, dtv_obj);
 
       for(const std::string& uq_col : uq_cols){
-        Migrations<<"ALTER TABLE " + new_it->first + " ADD ";
-        db_adapter::create_uq_constraint(uq_col, Migrations);
+        db_adapter::create_uq_constraint(new_it->first, uq_col, batch);
       }
       uq_cols.clear();
 
@@ -373,17 +628,15 @@ void Model::track_changes(const nlohmann::json& mrm, const nlohmann::json& frm,
             pk_constraint += new_it->first;
           }
         }
-        db_adapter::drop_constraint(new_it->first, pk_constraint, Migrations);
+        db_adapter::drop_constraint(new_it->first, pk_constraint, batch);
       }else if(mrm.empty() && !pk_cols.empty()){
-        db_adapter::drop_constraint(new_it->first, "pk_" + new_it->first , Migrations);
+        db_adapter::drop_constraint(new_it->first, "pk_" + new_it->first , batch);
       }else{
         continue;
       }
 
       if(!pk_cols.empty()){
-        Migrations<<"ALTER TABLE " + new_it->first + " ADD ";
-        db_adapter::create_pk_constraint(new_it->first, pk_cols, Migrations);
-        Migrations<<";\n";
+        db_adapter::create_pk_constraint(new_it->first, pk_cols, batch);
       }
       pk_cols.clear();
     }
@@ -397,8 +650,12 @@ void Model::track_changes(const nlohmann::json& mrm, const nlohmann::json& frm,
     }
     for(auto& [old_col, dtv_obj] : init_it->second){
       if(new_col_map.find(old_col) == new_col_map.end()){
-        db_adapter::drop_column(init_it->first, old_col, Migrations);
+        db_adapter::drop_column(init_it->first, old_col, batch);
       }
     }
   }
+
+  batch.flush(Migrations);
+  diff_indexes(original_ms, original_meta, mrm, frm, target_ms, new_meta, Migrations);
+  finish();
 }
@@ -0,0 +1,221 @@
+#pragma once
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "./db_adapters.hpp"
+
+#ifdef PSQL
+
+namespace psql::async{
+
+template <typename T = void>
+class Task;
+
+struct TaskPromiseBase{
+  std::coroutine_handle<> continuation;
+  std::exception_ptr error;
+
+  struct FinalAwaiter{
+    bool await_ready() noexcept { return false; }
+    template <typename Promise>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> finished) noexcept {
+      std::coroutine_handle<> next = finished.promise().continuation;
+      return next ? next : std::noop_coroutine();
+    }
+    void await_resume() noexcept {}
+  };
+
+  std::suspend_always initial_suspend() noexcept { return {}; }
+  FinalAwaiter final_suspend() noexcept { return {}; }
+  void unhandled_exception(){ error = std::current_exception(); }
+};
+
+template <typename T>
+struct TaskPromise : TaskPromiseBase{
+  std::optional<T> value;
+
+  Task<T> get_return_object();
+  void return_value(T v){ value.emplace(std::move(v)); }
+  T result(){
+    if(error) std::rethrow_exception(error);
+    return std::move(*value);
+  }
+};
+
+template <>
+struct TaskPromise<void> : TaskPromiseBase{
+  Task<void> get_return_object();
+  void return_void(){}
+  void result(){
+    if(error) std::rethrow_exception(error);
+  }
+};
+
+//Lazy coroutine: the body starts when the task is awaited or spawned on a Loop.
+template <typename T>
+class Task{
+public:
+  using promise_type = TaskPromise<T>;
+  using handle_type = std::coroutine_handle<promise_type>;
+
+  explicit Task(handle_type h): coro(h) {}
+  Task(Task&& other) noexcept : coro(std::exchange(other.coro, {})) {}
+  Task& operator=(Task&& other) noexcept {
+    if(this != &other){
+      if(coro) coro.destroy();
+      coro = std::exchange(other.coro, {});
+    }
+    return *this;
+  }
+  Task(const Task&) = delete;
+  Task& operator=(const Task&) = delete;
+  ~Task(){ if(coro) coro.destroy(); }
+
+  handle_type handle() const { return coro; }
+
+  bool await_ready() const noexcept { return false; }
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+    coro.promise().continuation = awaiting;
+    return coro;
+  }
+  T await_resume(){ return coro.promise().result(); }
+
+private:
+  handle_type coro;
+};
+
+template <typename T>
+Task<T> TaskPromise<T>::get_return_object(){
+  return Task<T>{Task<T>::handle_type::from_promise(*this)};
+}
+
+inline Task<void> TaskPromise<void>::get_return_object(){
+  return Task<void>{Task<void>::handle_type::from_promise(*this)};
+}
+
+class Loop;
+
+//Returns its connection to the loop's idle pool when destroyed.
+class Lease{
+  Loop* loop;
+  PGconn* cxn;
+public:
+  Lease(Loop& loop, PGconn* cxn): loop(&loop), cxn(cxn) {}
+  Lease(Lease&& other) noexcept : loop(other.loop), cxn(std::exchange(other.cxn, nullptr)) {}
+  Lease& operator=(Lease&&) = delete;
+  Lease(const Lease&) = delete;
+  ~Lease();
+
+  PGconn* get() const { return cxn; }
+};
+
+//Single-threaded reactor: suspended queries wait on their connection socket through poll().
+class Loop{
+public:
+  Loop() = default;
+  Loop(const Loop&) = delete;
+  Loop& operator=(const Loop&) = delete;
+  ~Loop();
+
+  static Loop& current();
+
+  void spawn(Task<void> task);
+  void run();
+
+  template <typename T>
+  T block_on(Task<T> task);
+
+  void wait_socket(int fd, bool write, std::coroutine_handle<> handle);
+  Task<Lease> acquire();
+  void release(PGconn* cxn);
+
+private:
+  struct Waiter{
+    int fd;
+    bool write;
+    std::coroutine_handle<> handle;
+  };
+
+  std::vector<Waiter> waiters;
+  std::vector<std::coroutine_handle<>> ready;
+  std::vector<Task<void>> tasks;
+  std::vector<PGconn*> idle;
+};
+
+struct SocketReady{
+  Loop& loop;
+  int fd;
+  bool write;
+
+  bool await_ready() const noexcept { return false; }
+  void await_suspend(std::coroutine_handle<> handle){ loop.wait_socket(fd, write, handle); }
+  void await_resume() const noexcept {}
+};
+
+template <typename T>
+Task<void> store_result(Task<T> task, std::optional<T>& out){
+  out.emplace(co_await task);
+}
+
+template <typename T>
+T Loop::block_on(Task<T> task){
+  if constexpr(std::is_void_v<T>){
+    spawn(std::move(task));
+    run();
+  }else{
+    std::optional<T> out {};
+    spawn(store_result(std::move(task), out));
+    run();
+    return std::move(*out);
+  }
+}
+
+Task<binary::Result> exec(std::string sql_string, std::vector<std::string> params = {});
+
+Task<void> execute(std::string sql_string, std::vector<std::string> params = {});
+
+template <typename tuple_T>
+Task<std::vector<tuple_T>> fetch_values(std::string sql_string, std::vector<std::string> params = {}){
+  binary::Result result = co_await exec(std::move(sql_string), std::move(params));
+  co_return binary::to_values<tuple_T>(result);
+}
+
+template <typename Model_T>
+Task<std::vector<Model_T>> fetch_instances(std::string sql_string, std::vector<std::string> params = {}){
+  std::vector<Model_T> instances {};
+  for(auto& values : co_await fetch_values<decltype(std::declval<Model_T>().get_attr())>(std::move(sql_string), std::move(params))){
+    instances.push_back(Model_T(std::move(values)));
+  }
+  co_return instances;
+}
+
+template <typename Model_T>
+Task<std::vector<Model_T>> fetch_all(const Model_T& obj){
+  return fetch_instances<Model_T>(query::select_statement(obj));
+}
+
+template <typename Model_T>
+Task<std::vector<Model_T>> filter(const Model_T& obj, std::string logical_op, Utils::filters& filters){
+  std::vector<std::string> params {};
+  pqxx::placeholders ph {};
+  std::string where_str = build_filter_sql(logical_op, filters, [&](const auto& v){ params.push_back(pqxx::to_string(v)); }, ph);
+  return fetch_instances<Model_T>(query::select_statement(obj) + " where " + where_str + ";", std::move(params));
+}
+
+template <typename tuple_T, std::size_t... I>
+std::vector<std::string> insert_params(const tuple_T& tup, std::index_sequence<I...>){
+  return {pqxx::to_string(std::get<I + 1>(tup))...};
+}
+
+template <typename Model_T>
+Task<void> exec_insert(const Model_T& instance){
+  using tuple_T = decltype(instance.get_attr());
+  return execute(insert_sql(instance), insert_params(instance.get_attr(), std::make_index_sequence<std::tuple_size_v<tuple_T> - 1>{}));
+}
+}
+
+#endif
@@ -8,10 +8,10 @@
 class FieldAttr{
 public:
 	std::string ctype, datatype, sql_segment;
-	bool primary_key, not_null, unique;
+	bool primary_key, not_null, unique, db_index;
 
-	FieldAttr(std::string ct = "null",std::string dt = "null", bool nn = false, bool uq = false, bool pk = false)
-	: ctype(ct), datatype(dt), not_null(nn), unique(uq), primary_key(pk)
+	FieldAttr(std::string ct = "null",std::string dt = "null", bool nn = false, bool uq = false, bool pk = false, bool idx = false)
+	: ctype(ct), datatype(dt), not_null(nn), unique(uq), primary_key(pk), db_index(idx)
 	{}
 
   ~FieldAttr() = default;
@@ -24,7 +24,7 @@ public:
 
   IntegerField() = default;
 	IntegerField(std::string datatype, bool pk = false, bool not_null = false, bool unique = false,
-              int check_constr = 0, std::string check_cond = "");
+              int check_constr = 0, std::string check_cond = "", bool db_index = false);
 
   ~IntegerField() = default;
 };
@@ -36,7 +36,7 @@ public:
 	int max_length, decimal_places;
 
   DecimalField() = default;
-	DecimalField(std::string datatype, int max_length, int decimal_places, bool pk = false);
+	DecimalField(std::string datatype, int max_length, int decimal_places, bool pk = false, bool db_index = false);
 
   ~DecimalField() = default;
 };
@@ -48,7 +48,7 @@ public:
 	int length;
 
   CharField() = default;
-	CharField(std::string datatype, int length = 0, bool not_null = false, bool unique = false, bool pk = false);
+	CharField(std::string datatype, int length = 0, bool not_null = false, bool unique = false, bool pk = false, bool db_index = false);
 
   ~CharField() = default;
 };
@@ -59,7 +59,7 @@ class BoolField:public FieldAttr{
 public:
 	bool enable_default, default_value;
 
-	BoolField(bool not_null = false, bool enable_default = false, bool default_value = false);
+	BoolField(bool not_null = false, bool enable_default = false, bool default_value = false, bool db_index = false);
 
   ~BoolField() = default;
 };
@@ -69,7 +69,7 @@ void from_json(const nlohmann::json& j, BoolField& field);
 class BinaryField: public FieldAttr{
 public:
   BinaryField() = default;
-	BinaryField(bool not_null, bool unique = false, bool pk = false);
+	BinaryField(bool not_null, bool unique = false, bool pk = false, bool db_index = false);
 
   ~BinaryField() = default;
 };
@@ -82,7 +82,7 @@ public:
 	std::string default_val;
 
   DateTimeField() = default;
-	DateTimeField(std::string datatype, bool enable_default = false, std::string default_val = "", bool pk = false);
+	DateTimeField(std::string datatype, bool enable_default = false, std::string default_val = "", bool pk = false, bool db_index = false);
 
   ~DateTimeField() = default;
 };
@@ -95,7 +95,7 @@ public:
 
   ForeignKey() = default;
 	ForeignKey(std::string cn, std::string mn, std::string rcn, std::optional<FieldAttr> pk_col_obj=std::nullopt,
-             std::string on_del="CASCADE", std::string on_upd="CASCADE");
+             std::string on_del="CASCADE", std::string on_upd="CASCADE", bool db_index = true);
 
   ~ForeignKey() = default;
 };
@@ -1,17 +1,34 @@
 #pragma once
+#include <algorithm>
 #include <any>
+#include <chrono>
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
 #include <exception>
+#include <functional>
 #include <iostream>
+#include <iterator>
+#include <list>
+#include <map>
 #include <optional>
+#include <mutex>
 #include <stdexcept>
+#include <thread>
 #include <type_traits>
 #include <variant>
 #include <vector>
 #include <string>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
 #include <fstream>
 #include <format>
 #include <concepts>
+#include <condition_variable>
 #include "./db_config.hpp"
 #include "./datatypes.hpp"
 #include "./models.hpp"
@@ -102,6 +119,7 @@ struct Condition {
   :column(col), op(op), value(v) {}
 };
 using filters = std::vector<Condition>;
+using assignments = std::vector<std::pair<std::string, Value_T>>;
 
 inline std::string build_filter_args(std::string logical_op, filters& filters){
   int op_size = logical_op.size();
@@ -122,6 +140,32 @@ typedef struct{
   int port;
 } db_params;
 db_params parse_db_conn_params();
+std::vector<db_params> parse_replica_conn_params();
+std::vector<db_params> parse_shard_conn_params();
+
+inline std::string join(const std::vector<std::string>& items, const std::string& sep = ","){
+  std::string joined {};
+  for(const std::string& item : items){
+    if(!joined.empty()) joined += sep;
+    joined += item;
+  }
+  return joined;
+}
+
+template <typename T, typename... Ts>
+std::tuple<Ts...> tail(const std::tuple<T, Ts...>& tup){
+  return std::apply([](const T&, const Ts&... rest){ return std::tuple<Ts...>{rest...}; }, tup);
+}
+
+//FNV-1a, used where a hash has to be stable across processes.
+inline std::uint64_t fnv1a(std::string_view data){
+  std::uint64_t hash = 14695981039346656037ull;
+  for(unsigned char ch : data){
+    hash ^= ch;
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
 
 template <typename T, std::size_t N>
 struct CustomArray{
@@ -157,6 +201,49 @@ struct CustomArray{
   constexpr std::size_t max_size() const { return N; }
 };
 
+template <typename T>
+struct view_of{ using type = T; };
+
+template <>
+struct view_of<std::string>{ using type = std::string_view; };
+
+template <typename... Ts>
+struct view_of<std::tuple<Ts...>>{ using type = std::tuple<typename view_of<Ts>::type...>; };
+
+template <typename T>
+using view_of_t = typename view_of<T>::type;
+
+//Runs fn(begin, end) over contiguous chunks of [0, n) on up to thread_count threads.
+//A thread_count of 0 uses every hardware thread.
+template <typename Fn>
+void parallel_chunks(std::size_t n, unsigned thread_count, Fn fn, std::size_t min_chunk = 1024){
+  if(thread_count == 0) thread_count = std::max(1u, std::thread::hardware_concurrency());
+  std::size_t chunks = std::min<std::size_t>(thread_count, (n + min_chunk - 1) / min_chunk);
+  if(chunks <= 1){
+    fn(std::size_t{0}, n);
+    return;
+  }
+
+  std::size_t chunk_size = (n + chunks - 1) / chunks;
+  std::vector<std::exception_ptr> errors(chunks);
+  std::vector<std::thread> workers {};
+  workers.reserve(chunks);
+
+  for(std::size_t c = 0; c < chunks; ++c){
+    workers.emplace_back([&, c]{
+      try{
+        fn(c * chunk_size, std::min(n, (c + 1) * chunk_size));
+      }catch(...){
+        errors[c] = std::current_exception();
+      }
+    });
+  }
+  for(std::thread& worker : workers) worker.join();
+  for(std::exception_ptr& error : errors){
+    if(error) std::rethrow_exception(error);
+  }
+}
+
 template <typename Arg>
 std::string to_str(const Arg& arg){
   std::ostringstream ss;
@@ -168,10 +255,52 @@ std::string to_str(const Arg& arg){
 #ifdef PSQL
 
 #include <pqxx/pqxx>
+#include <libpq-fe.h>
 
 namespace psql{
 
-inline void create_pk_constraint(const std::string& model_name, const std::vector<std::string>& pk_cols, std::ofstream& Migrations){
+//What an ALTER costs on Postgres 12+: a catalog change only, a scan that validates rows, or a rewrite of the table.
+enum AlterCost{METADATA=1, SCAN, REWRITE};
+
+//Collects ALTER TABLE actions per table so that flush() writes a single ALTER TABLE a, b, ... for each
+//table: one lock window and at most one rewrite. Statements registered through after() follow the ALTERs,
+//e.g. the backfill and VALIDATE of a NOT NULL change.
+class AlterBatch{
+public:
+  void add(const std::string& model_name, std::string action, AlterCost cost = METADATA);
+  void after(std::string statement);
+  void after(const std::string& model_name, std::string statement, AlterCost cost);
+  bool empty() const { return tables.empty() && trailing.empty(); }
+
+  //Also labels each ALTER, and each costly trailing statement, with its cost and, when the database is reachable,
+  //the table's size from pg_class.
+  void flush(std::ofstream& Migrations);
+
+private:
+  struct TableActions{
+    std::string model_name;
+    std::vector<std::string> actions;
+    AlterCost cost = METADATA;
+  };
+
+  struct Trailing{
+    std::string statement;
+    std::string model_name;
+    AlterCost cost = METADATA;
+  };
+
+  std::vector<Trailing> trailing;
+  std::vector<TableActions> tables;
+};
+
+//Migration files mark batched backfills with this comment, followed by table, column and the fill value.
+inline constexpr std::string_view backfill_directive = "-- strata:backfill ";
+
+//Statements between these comments are applied as one transaction, e.g. the swap at the end of an expand/contract.
+inline constexpr std::string_view begin_directive = "-- strata:begin";
+inline constexpr std::string_view commit_directive = "-- strata:commit";
+
+inline std::string pk_constraint_sql(const std::string& model_name, const std::vector<std::string>& pk_cols){
   std::string pk_seg = "CONSTRAINT pk_" + model_name + " PRIMARY KEY (" + model_name + "_id)";
   if (!pk_cols.empty()) {
     pk_seg.replace(pk_seg.length() - 1, 1, ",");
@@ -180,7 +309,15 @@ inline void create_pk_constraint(const std::string& model_name, const std::vecto
     }
     pk_seg.replace(pk_seg.length() - 1, 1, ")");
   }
-  Migrations<<pk_seg;
+  return pk_seg;
+}
+
+inline void create_pk_constraint(const std::string& model_name, const std::vector<std::string>& pk_cols, std::ofstream& Migrations){
+  Migrations<<pk_constraint_sql(model_name, pk_cols);
+}
+
+inline void create_pk_constraint(const std::string& model_name, const std::vector<std::string>& pk_cols, AlterBatch& batch){
+  batch.add(model_name, "ADD " + pk_constraint_sql(model_name, pk_cols), SCAN);
 }
 
 inline void create_fk_constraint(const std::string& model_name, const std::string& fk_sql_segment,
@@ -188,18 +325,33 @@ inline void create_fk_constraint(const std::string& model_name, const std::strin
   Migrations<< "CONSTRAINT fk_" + column_name + " " + fk_sql_segment;
 }
 
+inline void create_fk_constraint(const std::string& model_name, const std::string& fk_sql_segment,
+                                 const std::string& column_name, AlterBatch& batch){
+  batch.add(model_name, "ADD CONSTRAINT fk_" + column_name + " " + fk_sql_segment, SCAN);
+}
+
 inline void create_uq_constraint(const std::string& uq_col, std::ofstream& Migrations){
   Migrations<<"CONSTRAINT uq_" + uq_col + " UNIQUE (" + uq_col + "),\n";
 }
 
+inline void create_uq_constraint(const std::string& model_name, const std::string& uq_col, AlterBatch& batch){
+  batch.add(model_name, "ADD CONSTRAINT uq_" + uq_col + " UNIQUE (" + uq_col + ")", SCAN);
+}
+
 inline void create_column(const std::string& column_name, const std::string& column_sql_attributes, std::ofstream& Migrations){
   Migrations<<column_name + " " + column_sql_attributes;
 }
 
+//Writes the partitions a new partitioned table starts with: the HASH partitions, the current and next month
+//for RANGE on a DateTimeField, otherwise a DEFAULT partition so no insert is left without a target.
+void create_partitions(const std::string& model_name, const Partition& partition, bool date_column, std::ofstream& Migrations);
+
+//Partitioned tables need the partition column in every primary key and unique constraint.
 template <typename Col_Map>
-void create_table(const std::string& model_name, Col_Map& field_map, std::ofstream& Migrations){
+void create_table(const std::string& model_name, Col_Map& field_map, std::ofstream& Migrations, const Partition& partition = {}){
   std::vector<std::string> primary_key_cols;
   std::vector<std::string> unique_constraint_cols;
+  bool partitioned = !partition.strategy.empty();
 
   Migrations<< "CREATE TABLE IF NOT EXISTS " + model_name + " (\n  " + model_name + "_id SERIAL NOT NULL,\n  ";
 
@@ -228,35 +380,75 @@ void create_table(const std::string& model_name, Col_Map& field_map, std::ofstre
 
   for(std::string& col: unique_constraint_cols){
     Migrations << "  ";
-    create_uq_constraint(col, Migrations);
+    if(partitioned && col != partition.column)
+      Migrations<<"CONSTRAINT uq_" + col + " UNIQUE (" + col + ", " + partition.column + "),\n";
+    else
+      create_uq_constraint(col, Migrations);
   }
 
+  if(partitioned && std::find(primary_key_cols.begin(), primary_key_cols.end(), partition.column) == primary_key_cols.end())
+    primary_key_cols.push_back(partition.column);
+
   Migrations << "  ";
   create_pk_constraint(model_name, primary_key_cols, Migrations);
-  Migrations<< "\n);\n\n";
+  Migrations<< "\n)";
+  if(partitioned) Migrations<< " PARTITION BY " + partition.strategy + " (" + partition.column + ")";
+  Migrations<< ";\n\n";
+
+  if(!partitioned) return;
+  bool date_column = false;
+  auto partition_it = field_map.find(partition.column);
+  if(partition_it != field_map.end())
+    date_column = std::holds_alternative<std::shared_ptr<DateTimeField>>(partition_it->second);
+  create_partitions(model_name, partition, date_column, Migrations);
 }
 
 void alter_rename_table(const std::string& old_model_name, const std::string& new_model_name, std::ofstream& Migrations);
 
 void alter_add_column(const std::string& model_name, const std::string& column_name,
-                      const std::string& column_sql_attributes, std::ofstream& Migrations);
+                      const std::string& column_sql_attributes, AlterBatch& batch);
 
 void alter_rename_column(const std::string& model_name, const std::string& old_column_name,
                          const std::string& new_column_name, std::ofstream& Migrations);
 
+AlterCost type_change_cost(const std::string& from_sql, const std::string& to_sql);
+
 void alter_column_type(const std::string& model_name, const std::string& column_name,
-                       const std::string& sql_segment, std::ofstream& Migrations);
+                       const std::string& sql_segment, AlterBatch& batch, AlterCost cost = REWRITE);
+
+//Expand/contract alternative to a rewriting type change: a shadow column kept in sync by a trigger is backfilled in
+//batches and given the column's NOT NULL, UNIQUE, default and indexes before it is swapped in. Values are cast to the
+//unconstrained base type, so the column's own length or precision rejects values that no longer fit instead of truncating.
+//A NOT NULL column's NULLs become fill_sql in the trigger and the backfill, so the caller must not stage the NOT NULL itself.
+void expand_contract_column(const std::string& model_name, const std::string& column_name, const std::string& sql_segment,
+                            const FieldAttr& field, const std::string& default_sql, const std::string& fill_sql,
+                            const std::map<std::string, Index>& indexes, bool partitioned, AlterBatch& batch);
 
 void alter_column_defaultval(const std::string& model_name, const std::string& column_name,
-                             const bool set_default, const std::string& defaultval, std::ofstream& Migrations);
+                             const bool set_default, const std::string& defaultval, AlterBatch& batch);
 
-void alter_column_nullable(const std::string& model_name, const std::string& column_name, const bool nullable, std::ofstream& Migrations);
+//SET NOT NULL is staged so no step holds an ACCESS EXCLUSIVE lock while scanning: a NOT VALID CHECK guards new rows,
+//existing NULLs are backfilled with fill_value in id-range batches, then the check is validated and SET NOT NULL reuses it.
+//Without a fill_value nothing is backfilled and VALIDATE fails if NULLs remain.
+void alter_column_nullable(const std::string& model_name, const std::string& column_name, const bool nullable, AlterBatch& batch,
+                           const std::string& fill_value = "");
 
 void drop_table(const std::string& model_name, std::ofstream& Migrations);
 
-void drop_column(const std::string& model_name, const std::string& column_name, std::ofstream& Migrations);
+void drop_column(const std::string& model_name, const std::string& column_name, AlterBatch& batch);
+
+void drop_constraint(const std::string& model_name, const std::string& constraint_name, AlterBatch& batch);
 
-void drop_constraint(const std::string& model_name, const std::string& constraint_name, std::ofstream& Migrations);
+std::string index_name(const std::string& model_name, const Index& index);
+
+//Every index a model should have, keyed by name: db_index fields plus the model-level list.
+std::map<std::string, Index> table_indexes(const std::string& model_name, const fields& field_map, const ModelMeta& meta);
+
+std::string index_sql(const std::string& model_name, const Index& index, bool concurrently);
+
+void create_index(const std::string& model_name, const Index& index, bool concurrently, std::ofstream& Migrations);
+
+void drop_index(const std::string& index_name, bool concurrently, std::ofstream& Migrations);
 
 void generate_int_sql(IntegerField& int_obj);
 
@@ -272,18 +464,106 @@ void generate_datetime_sql(DateTimeField& dt_obj);
 
 void generate_foreignkey_sql(ForeignKey& fk_obj);
 
-void create_models_hpp(const ms_map& migrations);
+void create_models_hpp(const ms_map& migrations, const meta_map& meta);
+
+inline std::string conn_string(const Utils::db_params& params){
+  return "dbname=" + params.db_name +
+         " user=" + params.user +
+         " password=" + params.passwd +
+         " host=" + params.host +
+         " port=" + std::to_string(params.port);
+}
+
+enum Route{
+  PRIMARY=1,
+  REPLICA
+};
+
+//Per-thread view of the database: remembers the primary's WAL position after our own writes
+//so replica reads only go to replicas that have replayed them.
+class Session{
+public:
+  std::uint64_t last_write_lsn = 0;
+  std::chrono::milliseconds replica_wait {200};
+  std::chrono::milliseconds statement_timeout {0};
+
+  static Session& current();
+
+  void record_write(pqxx::connection& cxn);
+  bool caught_up(pqxx::connection& replica_cxn) const;
+
+  static std::uint64_t parse_lsn(const std::string& lsn);
+  static std::string format_lsn(std::uint64_t lsn);
+};
+
+class timeout_error : public std::runtime_error{
+public:
+  using std::runtime_error::runtime_error;
+};
+
+//Overrides the session's statement_timeout for the queries run inside its scope.
+class ScopedTimeout{
+  std::chrono::milliseconds previous;
+public:
+  explicit ScopedTimeout(std::chrono::milliseconds timeout): previous(Session::current().statement_timeout){
+    Session::current().statement_timeout = timeout;
+  }
+  ScopedTimeout(const ScopedTimeout&) = delete;
+  ~ScopedTimeout(){ Session::current().statement_timeout = previous; }
+};
+
+//Sets statement_timeout for the transaction and cancels the running query from a watchdog
+//thread if the server hasn't given up shortly after the deadline.
+class Deadline{
+  std::function<void()> cancel;
+  std::thread watchdog;
+  std::mutex mtx;
+  std::condition_variable cv;
+  bool finished = false;
+
+  void arm(std::chrono::milliseconds timeout);
+public:
+  Deadline(pqxx::connection& cxn, pqxx::transaction_base& txn, std::chrono::milliseconds timeout = Session::current().statement_timeout);
+  //For a libpq handle lent by Pool::Lease::with_raw(), which must already be inside a transaction block.
+  explicit Deadline(PGconn* raw, std::chrono::milliseconds timeout = Session::current().statement_timeout);
+  Deadline(const Deadline&) = delete;
+  ~Deadline();
+};
+
+//Routes reads across the replicas listed in config.json and everything else to the primary.
+//Replicas are picked by comparing the smoothed latency of two random healthy candidates,
+//failing replicas are ejected for a growing cooldown. A replica that hasn't replayed the
+//session's last write within Session::replica_wait is skipped.
+class Router{
+public:
+  static Router& instance();
+
+  bool has_replicas() const { return !replicas.empty(); }
+  //served_by, when given, receives the node actually reached: a REPLICA request falls back to the primary.
+  pqxx::connection connect(Route route, Route* served_by = nullptr);
+  void observe(const pqxx::connection& cxn, std::chrono::steady_clock::duration latency, bool ok);
+
+private:
+  struct Replica{
+    Utils::db_params params;
+    double latency_ms = 0;
+    int failures = 0;
+    std::chrono::steady_clock::time_point ejected_until {};
+  };
+
+  Router();
+  int pick_replica(const std::vector<int>& tried);
+  bool wait_for_replay(pqxx::connection& cxn, const Session& session, std::chrono::steady_clock::time_point deadline);
+  void observe(int replica, std::chrono::steady_clock::duration latency, bool ok);
+
+  std::mutex mtx;
+  Utils::db_params primary;
+  std::vector<Replica> replicas;
+};
 
-inline pqxx::connection connect(){
-  Utils::db_params params = Utils::parse_db_conn_params();
+inline pqxx::connection connect(Route route = PRIMARY, Route* served_by = nullptr){
   try{
-    pqxx::connection cxn("dbname=" + params.db_name+
-                         " user=" + params.user +
-                         " password=" + params.passwd +
-                         " host=" + params.host +
-                         " port=" + std::to_string(params.port)
-                         );
-    return cxn;
+    return Router::instance().connect(route, served_by);
   }catch (const std::exception& e){
     throw std::runtime_error(std::format("[ERROR: in 'connect()'] => {}", e.what()));
   }
@@ -291,30 +571,110 @@ inline pqxx::connection connect(){
 
 template<typename Model_T>
 void dbfetch(Model_T& obj, std::string& sql_string, bool getfn_called = false){
-  pqxx::connection cxn= connect();
+  pqxx::connection cxn= connect(REPLICA);
+  auto start = std::chrono::steady_clock::now();
   try{
     pqxx::work txn(cxn);
+    Deadline deadline {cxn, txn};
 
     if(getfn_called){
       pqxx::result result = txn.exec(sql_string).expect_rows(1);
       obj.records.push_back(result[0]);
+      Router::instance().observe(cxn, std::chrono::steady_clock::now() - start, true);
       return;
     }
 
     for(const pqxx::row& row : txn.exec(sql_string)) obj.records.push_back(row);
 
     txn.commit();
+    Router::instance().observe(cxn, std::chrono::steady_clock::now() - start, true);
+  }catch (const pqxx::query_canceled& e){
+    throw timeout_error(std::format("[ERROR: in 'db_fetch()'] => {}", e.what()));
+  }catch (const pqxx::broken_connection& e){
+    Router::instance().observe(cxn, std::chrono::steady_clock::now() - start, false);
+    throw std::runtime_error(std::format("[ERROR: in 'db_fetch()'] => {}", e.what()));
   }catch (const std::exception& e){
     throw std::runtime_error(std::format("[ERROR: in 'db_fetch()'] => {}", e.what()));
   }
   return;
 }
 
+//Idle connections kept per node. Each one remembers the statements prepared on it, so a statement
+//shape is parsed and planned once per connection; the least recently used ones are deallocated
+//past max_prepared.
+class Pool{
+  struct PooledConnection{
+    pqxx::connection cxn;
+    Route node;
+    std::list<std::string> recent;
+    std::unordered_map<std::string, std::list<std::string>::iterator> prepared;
+  };
+public:
+  class Lease{
+    Pool* pool;
+    std::unique_ptr<PooledConnection> conn;
+  public:
+    Lease(Pool& pool, std::unique_ptr<PooledConnection> conn): pool(&pool), conn(std::move(conn)) {}
+    Lease(Lease&&) = default;
+    Lease& operator=(Lease&&) = default;
+    ~Lease(){ if(conn) pool->release(std::move(conn)); }
+
+    pqxx::connection& cxn(){ return conn->cxn; }
+    std::string prepare(const std::string& sql_string);
+
+    //Lends the libpq handle to fn for what libpqxx doesn't expose, eg binary results. The lease keeps owning it.
+    template <typename Fn_T>
+    decltype(auto) with_raw(Fn_T&& fn){
+      struct Reseize{
+        PooledConnection& conn;
+        PGconn* raw;
+        ~Reseize(){ conn.cxn = pqxx::connection::seize_raw_connection(raw); }
+      } reseize {*conn, std::move(conn->cxn).release_raw_connection()};
+      return fn(reseize.raw);
+    }
+  };
+
+  std::size_t max_idle = 8;
+  std::size_t max_prepared = 256;
+
+  static Pool& instance();
+  Lease acquire(Route route);
+
+private:
+  void release(std::unique_ptr<PooledConnection> conn);
+
+  std::mutex mtx;
+  std::vector<std::unique_ptr<PooledConnection>> idle_primary;
+  std::vector<std::unique_ptr<PooledConnection>> idle_replica;
+};
+
+//Classes emitted by create_models_hpp() carry their SQL as static constexpr members, so the
+//hot paths below copy those instead of rebuilding statements from table_name and col_str.
+template <typename Model_T>
+concept static_sql = requires {
+  { Model_T::select_list } -> std::convertible_to<std::string_view>;
+  { Model_T::select_sql } -> std::convertible_to<std::string_view>;
+  { Model_T::insert_sql } -> std::convertible_to<std::string_view>;
+};
+
+//Generated classes also list each column's SQL type, in col_str order.
+template <typename Model_T>
+concept typed_columns = requires {
+  { Model_T::sql_types.size() } -> std::convertible_to<std::size_t>;
+  { Model_T::sql_types[0] } -> std::convertible_to<std::string_view>;
+};
+
+//And the columns of each unique constraint, comma separated, as usable ON CONFLICT targets.
+template <typename Model_T>
+concept keyed_columns = requires {
+  { Model_T::unique_keys.size() } -> std::convertible_to<std::size_t>;
+};
+
 template<typename Model_T>
-pqxx::connection prepare_insert(){
-  Model_T obj {};
+std::string insert_sql(const Model_T& obj){
+  if constexpr(static_sql<Model_T>) return std::string(Model_T::insert_sql);
+
   pqxx::placeholders row_vals;
-  pqxx::connection cxn = connect();
   std::string insert_statement = "insert into "+ obj.table_name + " (" + obj.col_str +") values(";
 
   for(int i=0; i<obj.col_map_size; ++i){
@@ -324,21 +684,449 @@ pqxx::connection prepare_insert(){
 
   insert_statement.pop_back();
   insert_statement.append(");");
-  cxn.prepare("insert_stmt", insert_statement);
+  return insert_statement;
+}
+
+template<typename Model_T>
+pqxx::connection prepare_insert(){
+  Model_T obj {};
+  pqxx::connection cxn = connect();
+  cxn.prepare("insert_stmt", insert_sql(obj));
 
   return cxn;
 }
 
 void exec_insert(pqxx::connection& cxn, pqxx::params& p);
 
+template<typename tuple_T>
+std::vector<tuple_T> dbfetch_binary(const std::string& sql_string, const std::vector<std::string>& params = {});
+
+template <typename Model_T>
+pqxx::params row_params(const Model_T& instance){
+  pqxx::params params {};
+  std::apply([&](const auto&, const auto&... cols){
+    (params.append(cols), ...);
+  }, instance.get_attr());
+  return params;
+}
+
+template <typename T>
+T decode_field(const pqxx::field& field){
+  if constexpr(std::is_same_v<T, std::string_view>) return field.view();
+  else return field.template as<T>();
+}
+
+template <typename tuple_T, std::size_t... I>
+tuple_T decode_row(const pqxx::row& row, std::size_t offset, std::index_sequence<I...>){
+  return tuple_T{decode_field<std::tuple_element_t<I, tuple_T>>(row[static_cast<pqxx::row::size_type>(offset + I)])...};
+}
+
+template <typename tuple_T>
+tuple_T decode_row(const pqxx::row& row, std::size_t offset = 0){
+  constexpr std::size_t N = std::tuple_size_v<tuple_T>;
+  if(static_cast<std::size_t>(row.size()) < offset + N)
+    throw std::runtime_error(std::format("[ERROR: in 'decode_row()'] => Row has {} columns, expected at least {}.", row.size(), offset + N));
+  return decode_row<tuple_T>(row, offset, std::make_index_sequence<N>{});
+}
+
+template <typename view_T, std::size_t... I>
+std::size_t string_bytes(const view_T& tup, std::index_sequence<I...>){
+  std::size_t bytes = 0;
+  ([&]{
+    if constexpr(std::is_same_v<std::tuple_element_t<I, view_T>, std::string_view>) bytes += std::get<I>(tup).size();
+  }(), ...);
+  return bytes;
+}
+
+template <typename view_T, std::size_t... I>
+void pack_strings(view_T& tup, char*& cursor, std::index_sequence<I...>){
+  ([&]{
+    if constexpr(std::is_same_v<std::tuple_element_t<I, view_T>, std::string_view>){
+      std::string_view& str = std::get<I>(tup);
+      std::memcpy(cursor, str.data(), str.size());
+      str = std::string_view(cursor, str.size());
+      cursor += str.size();
+    }
+  }(), ...);
+}
+
+//Values whose string_views point into one arena allocation owned alongside them.
+template <typename view_T>
+struct ArenaValues{
+  std::unique_ptr<char[]> arena;
+  std::vector<view_T> values;
+};
+
+namespace binary{
+
+enum PG_OID : Oid{
+  BOOLOID = 16,
+  BYTEAOID = 17,
+  NAMEOID = 19,
+  INT8OID = 20,
+  INT2OID = 21,
+  INT4OID = 23,
+  TEXTOID = 25,
+  OIDOID = 26,
+  FLOAT4OID = 700,
+  FLOAT8OID = 701,
+  BPCHAROID = 1042,
+  VARCHAROID = 1043,
+  DATEOID = 1082,
+  TIMEOID = 1083,
+  TIMESTAMPOID = 1114,
+  TIMESTAMPTZOID = 1184,
+  NUMERICOID = 1700
+};
+
+using timestamp = std::chrono::sys_time<std::chrono::microseconds>;
+
+class Result{
+  std::unique_ptr<PGresult, decltype(&PQclear)> res;
+public:
+  explicit Result(PGresult* result): res(result, &PQclear) {}
+
+  PGresult* get() const { return res.get(); }
+  int size() const { return PQntuples(res.get()); }
+  int columns() const { return PQnfields(res.get()); }
+  Oid column_type(int col) const { return PQftype(res.get(), col); }
+  bool is_null(int row, int col) const { return PQgetisnull(res.get(), row, col); }
+  std::string_view value(int row, int col) const {
+    return std::string_view(PQgetvalue(res.get(), row, col), PQgetlength(res.get(), row, col));
+  }
+};
+
+//Runs one read on a pooled REPLICA connection with results in binary format. params are sent as text.
+Result exec(const std::string& sql_string, const std::vector<std::string>& params = {});
+
+template <typename T>
+T read_be(const char* data){
+  std::make_unsigned_t<T> value = 0;
+  for(std::size_t i = 0; i < sizeof(T); ++i){
+    value = static_cast<std::make_unsigned_t<T>>((value << 8) | static_cast<unsigned char>(data[i]));
+  }
+  return static_cast<T>(value);
+}
+
+bool is_textual(Oid type);
+std::int64_t decode_int(Oid type, std::string_view raw);
+double decode_float(Oid type, std::string_view raw);
+timestamp decode_timestamp(Oid type, std::string_view raw);
+std::string decode_text(Oid type, std::string_view raw);
+
+template <typename T>
+T decode_value(const Result& res, int row, int col){
+  if(res.is_null(row, col))
+    throw std::runtime_error(std::format("[ERROR: in 'binary::decode_value()'] => Null value in column '{}'.", PQfname(res.get(), col)));
+
+  Oid type = res.column_type(col);
+  std::string_view raw = res.value(row, col);
+
+  if constexpr(std::is_same_v<T, bool>){
+    if(type != BOOLOID) throw std::runtime_error("[ERROR: in 'binary::decode_value()'] => Column is not a boolean.");
+    return raw[0] != 0;
+  }else if constexpr(std::is_integral_v<T>){
+    std::int64_t value = decode_int(type, raw);
+    if(!std::in_range<T>(value))
+      throw std::runtime_error(std::format("[ERROR: in 'binary::decode_value()'] => Value {} does not fit the field type.", value));
+    return static_cast<T>(value);
+  }else if constexpr(std::is_floating_point_v<T>){
+    return static_cast<T>(decode_float(type, raw));
+  }else if constexpr(std::is_same_v<T, timestamp>){
+    return decode_timestamp(type, raw);
+  }else if constexpr(std::is_same_v<T, std::string_view>){
+    if(!is_textual(type)) throw std::runtime_error("[ERROR: in 'binary::decode_value()'] => Only text columns can be viewed.");
+    return raw;
+  }else if constexpr(std::is_same_v<T, std::string>){
+    return decode_text(type, raw);
+  }else{
+    static_assert(sizeof(T) == 0, "[ERROR: 'binary::decode_value()'] => Unsupported field type for binary results.");
+  }
+}
+
+template <typename tuple_T, std::size_t... I>
+tuple_T decode_row(const Result& res, int row, std::index_sequence<I...>){
+  return tuple_T{decode_value<std::tuple_element_t<I, tuple_T>>(res, row, static_cast<int>(I))...};
+}
+
+template <typename tuple_T>
+std::vector<tuple_T> to_values(const Result& res){
+  constexpr std::size_t N = std::tuple_size_v<tuple_T>;
+  if(static_cast<std::size_t>(res.columns()) != N)
+    throw std::runtime_error(std::format("[ERROR: in 'binary::to_values()'] => Result has {} columns, expected {}.", res.columns(), N));
+
+  std::vector<tuple_T> values {};
+  values.reserve(res.size());
+  for(int row = 0; row < res.size(); ++row){
+    values.push_back(decode_row<tuple_T>(res, row, std::make_index_sequence<N>{}));
+  }
+  return values;
+}
+
+template <typename tuple_T>
+std::vector<tuple_T> to_values(const Result& res, unsigned thread_count){
+  constexpr std::size_t N = std::tuple_size_v<tuple_T>;
+  if(static_cast<std::size_t>(res.columns()) != N)
+    throw std::runtime_error(std::format("[ERROR: in 'binary::to_values()'] => Result has {} columns, expected {}.", res.columns(), N));
+
+  std::vector<tuple_T> values(res.size());
+  Utils::parallel_chunks(values.size(), thread_count, [&](std::size_t begin, std::size_t end){
+    for(std::size_t row = begin; row < end; ++row){
+      values[row] = decode_row<tuple_T>(res, static_cast<int>(row), std::make_index_sequence<N>{});
+    }
+  });
+  return values;
+}
+}
+
+template<typename tuple_T>
+std::vector<tuple_T> dbfetch_binary(const std::string& sql_string, const std::vector<std::string>& params){
+  try{
+    return binary::to_values<tuple_T>(binary::exec(sql_string, params));
+  }catch (const timeout_error& e){
+    throw timeout_error(std::format("[ERROR: in 'dbfetch_binary()'] => {}", e.what()));
+  }catch (const std::exception& e){
+    throw std::runtime_error(std::format("[ERROR: in 'dbfetch_binary()'] => {}", e.what()));
+  }
+}
+
+//append receives the condition's bound value, so the same SQL can be sent with pqxx::params or as text parameters.
+template <typename Append_T>
+std::string condition_sql(const Utils::Condition& filter, Append_T&& append, pqxx::placeholders& ph){
+  std::string op {};
+  switch(filter.op){
+    case EQ: op = " = "; break;
+    case GT: op = " > "; break;
+    case LT: op = " < "; break;
+    case GTE: op = " >= "; break;
+    case LTE: op = " <= "; break;
+    case LIKE:
+    case STARTSWITH:
+    case ENDSWITH:
+    case CONTAINS: op = " like "; break;
+    case ILIKE: op = " ilike "; break;
+    default:
+      throw std::runtime_error("[ERROR: in 'build_filter_sql()'] => Unknown operator!");
+  }
+
+  if(filter.op == STARTSWITH || filter.op == ENDSWITH || filter.op == CONTAINS){
+    const std::string* pattern = std::get_if<std::string>(&filter.value);
+    if(!pattern) throw std::runtime_error("[ERROR: in 'build_filter_sql()'] => Pattern operators need a string value.");
+    append((filter.op == STARTSWITH ? "" : "%") + *pattern + (filter.op == ENDSWITH ? "" : "%"));
+  }else{
+    std::visit([&](const auto& v){ append(v); }, filter.value);
+  }
+  std::string condition_str = filter.column + op + ph.get();
+  ph.next();
+  return condition_str;
+}
+
+inline std::string condition_sql(const Utils::Condition& filter, pqxx::params& params, pqxx::placeholders& ph){
+  return condition_sql(filter, [&](const auto& v){ params.append(v); }, ph);
+}
+
+//SQL LIKE semantics: % matches any run of characters, _ exactly one, and a backslash escapes the next one.
+inline bool like_match(std::string_view text, std::string_view pattern, bool fold_case){
+  auto same = [&](char a, char b){
+    return fold_case ? std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b)) : a == b;
+  };
+  std::size_t t = 0, p = 0, resume_p = std::string_view::npos, resume_t = 0;
+  while(t < text.size()){
+    if(p < pattern.size() && pattern[p] == '%'){
+      resume_p = ++p;
+      resume_t = t;
+      continue;
+    }
+    if(p < pattern.size()){
+      bool escaped = pattern[p] == '\\' && p + 1 < pattern.size();
+      char expected = pattern[escaped ? p + 1 : p];
+      if((!escaped && expected == '_') || same(expected, text[t])){
+        p += escaped ? 2 : 1;
+        ++t;
+        continue;
+      }
+    }
+    if(resume_p == std::string_view::npos) return false;
+    p = resume_p;
+    t = ++resume_t;
+  }
+  while(p < pattern.size() && pattern[p] == '%') ++p;
+  return p == pattern.size();
+}
+
+//In-memory counterpart of condition_sql(): same operators, same patterns, and NULL never matches.
+inline bool condition_matches(const pqxx::field& field, const Utils::Condition& filter){
+  if(field.is_null()) return false;
+
+  switch(filter.op){
+    case LIKE:
+    case ILIKE:
+    case STARTSWITH:
+    case ENDSWITH:
+    case CONTAINS:{
+      std::string pattern = std::visit([](const auto& v) -> std::string {
+        if constexpr(std::is_same_v<std::decay_t<decltype(v)>, std::string>) return v;
+        else return pqxx::to_string(v);
+      }, filter.value);
+      if(filter.op == STARTSWITH || filter.op == ENDSWITH || filter.op == CONTAINS){
+        if(!std::holds_alternative<std::string>(filter.value))
+          throw std::runtime_error("[ERROR: in 'condition_matches()'] => Pattern operators need a string value.");
+        pattern = (filter.op == STARTSWITH ? "" : "%") + pattern + (filter.op == ENDSWITH ? "" : "%");
+      }
+      return like_match(field.c_str(), pattern, filter.op == ILIKE);
+    }
+    case EQ:
+    case GT:
+    case LT:
+    case GTE:
+    case LTE:{
+      //Strings compare bytewise, i.e. like the C collation.
+      int order = std::visit([&](const auto& v) -> int {
+        if constexpr(std::is_same_v<std::decay_t<decltype(v)>, std::string>){
+          int cmp = std::string_view(field.c_str()).compare(v);
+          return (cmp > 0) - (cmp < 0);
+        }else{
+          double lhs = field.as<double>(), rhs = static_cast<double>(v);
+          return (lhs > rhs) - (lhs < rhs);
+        }
+      }, filter.value);
+      switch(filter.op){
+        case EQ: return order == 0;
+        case GT: return order > 0;
+        case LT: return order < 0;
+        case GTE: return order >= 0;
+        default: return order <= 0;
+      }
+    }
+    default:
+      throw std::runtime_error("[ERROR: in 'condition_matches()'] => Unknown operator!");
+  }
+}
+
+template <typename Append_T>
+std::string build_filter_sql(const std::string& logical_op, Utils::filters& filters, Append_T&& append, pqxx::placeholders& ph){
+  if(logical_op != "and" && logical_op != "or")
+    throw std::runtime_error(std::format("[ERROR: in 'build_filter_sql()'] => Unknown logical operator: {}", logical_op));
+
+  std::string where_str {};
+  for(Utils::Condition& filter : filters){
+    if(!where_str.empty()) where_str += " " + logical_op + " ";
+    where_str += condition_sql(filter, append, ph);
+  }
+  return where_str;
+}
+
+inline std::string build_filter_sql(const std::string& logical_op, Utils::filters& filters, pqxx::params& params, pqxx::placeholders& ph){
+  return build_filter_sql(logical_op, filters, [&](const auto& v){ params.append(v); }, ph);
+}
+
+template <typename T>
+constexpr const char* sql_cast(){
+  if constexpr(std::is_same_v<T, bool>) return "boolean";
+  else if constexpr(std::is_same_v<T, short>) return "smallint";
+  else if constexpr(std::is_integral_v<T> && sizeof(T) <= 4) return "integer";
+  else if constexpr(std::is_integral_v<T>) return "bigint";
+  else if constexpr(std::is_floating_point_v<T>) return "double precision";
+  else return "text";
+}
+
+inline pqxx::result exec_write_result(const std::string& sql_string, pqxx::params& params, const char* caller){
+  Pool::Lease lease = Pool::instance().acquire(PRIMARY);
+  try{
+    pqxx::work txn(lease.cxn());
+    pqxx::result result {};
+    {
+      Deadline deadline {lease.cxn(), txn};
+      result = txn.exec(pqxx::prepped{lease.prepare(sql_string)}, params);
+    }
+    txn.commit();
+    Session::current().record_write(lease.cxn());
+    return result;
+  }catch(const pqxx::query_canceled& e){
+    throw timeout_error(std::format("[ERROR: in '{}'] => {}", caller, e.what()));
+  }catch(const std::exception& e){
+    throw std::runtime_error(std::format("[ERROR: in '{}'] => {}", caller, e.what()));
+  }
+}
+
+inline std::size_t exec_write(const std::string& sql_string, pqxx::params& params, const char* caller){
+  return exec_write_result(sql_string, params, caller).affected_rows();
+}
+
+template <typename Model_T>
+void dbfetch(Model_T& obj, const std::string& sql_string, pqxx::params& params){
+  Pool::Lease lease = Pool::instance().acquire(REPLICA);
+  auto start = std::chrono::steady_clock::now();
+  try{
+    pqxx::work txn(lease.cxn());
+    {
+      Deadline deadline {lease.cxn(), txn};
+      for(const pqxx::row& row : txn.exec(pqxx::prepped{lease.prepare(sql_string)}, params)) obj.records.push_back(row);
+    }
+    txn.commit();
+    Router::instance().observe(lease.cxn(), std::chrono::steady_clock::now() - start, true);
+  }catch (const pqxx::query_canceled& e){
+    throw timeout_error(std::format("[ERROR: in 'db_fetch()'] => {}", e.what()));
+  }catch (const pqxx::broken_connection& e){
+    Router::instance().observe(lease.cxn(), std::chrono::steady_clock::now() - start, false);
+    throw std::runtime_error(std::format("[ERROR: in 'db_fetch()'] => {}", e.what()));
+  }catch (const std::exception& e){
+    throw std::runtime_error(std::format("[ERROR: in 'db_fetch()'] => {}", e.what()));
+  }
+}
+
 namespace query{
 
+constexpr std::size_t bulk_batch_size = 500;
+
+template <typename Model_T>
+std::string select_columns(const Model_T& obj){
+  if constexpr(static_sql<Model_T>) return std::string(Model_T::select_list);
+  else return obj.table_name + "_id," + obj.col_str;
+}
+
+template <typename Model_T>
+std::string select_statement(const Model_T& obj){
+  if constexpr(static_sql<Model_T>) return std::string(Model_T::select_sql);
+  else return "select " + select_columns(obj) + " from " + obj.table_name;
+}
+
+//Every column, in get_attr() order, through the generated select_sql when the model has one.
+template <typename Model_T>
+void fetch_all(Model_T& obj){
+  std::string sql_string {select_statement(obj) + ";"};
+  dbfetch(obj, sql_string);
+}
+
 template <typename Model_T>
 void fetch_all(Model_T& obj, std::string columns){
+  if(columns == "*" || columns == select_columns(obj)) return fetch_all(obj);
   std::string sql_string {"select " + columns + " from " + obj.table_name + ";"};
   dbfetch(obj, sql_string);
 }
 
+template <typename Model_T>
+std::vector<decltype(std::declval<Model_T>().get_attr())> fetch_values_binary(Model_T& obj){
+  return dbfetch_binary<decltype(obj.get_attr())>(select_statement(obj));
+}
+
+template <typename Model_T>
+std::vector<decltype(std::declval<Model_T>().get_attr())> fetch_values_binary(Model_T& obj, std::string logical_op, Utils::filters& filters){
+  std::vector<std::string> params {};
+  pqxx::placeholders ph {};
+  std::string where_str = build_filter_sql(logical_op, filters, [&](const auto& v){ params.push_back(pqxx::to_string(v)); }, ph);
+  return dbfetch_binary<decltype(obj.get_attr())>(select_statement(obj) + " where " + where_str + ";", params);
+}
+
+template <typename Model_T, typename... Args>
+std::vector<Model_T> fetch_instances_binary(Model_T& obj, Args&&... args){
+  std::vector<Model_T> instances {};
+  for(auto& values : fetch_values_binary(obj, std::forward<Args>(args)...)){
+    instances.push_back(Model_T(std::move(values)));
+  }
+  return instances;
+}
+
 template <typename Model_T, typename... Args>
 void get(Model_T& obj, Args... args){
   static_assert(sizeof...(args) > 0 || sizeof...(args)%2 == 0, "[ERROR:'db_adapter::query::get()'] => Args are provided in key-value pairs.");
@@ -443,26 +1231,166 @@ inline bool matches_conditions(pqxx::field&& field, OP op, Utils::Value_T v){
   return accept;
 }
 
-template <typename Model_T>
-void filter(Model_T& obj, std::string logical_op, Utils::filters& filters){
-  if(obj.records.empty()){
-    std::string sql_str = "select * from " + obj.table_name + " where " + build_filter_args(logical_op, filters) + ";";
-    std::cout<<sql_str<<std::endl;
-    dbfetch(obj, sql_str);
-  }else{
-    std::vector<pqxx::row> filtered_rows {};
-    if (logical_op == "and"){
-      for(const pqxx::row& row : obj.records){
-        bool accept_row = true;
-        for(Utils::Condition& filter: filters){
-          if(!matches_conditions(row.at(filter.column), filter.op, filter.value)){
-            accept_row = false;
-            break;
-          }
-        }
-        if(accept_row){
-          filtered_rows.push_back(row);
-          continue;
+class Q;
+
+//Inner select used as a filter value, so semi-joins and anti-joins stay server-side.
+class Subquery{
+public:
+  template <typename Model_T>
+  explicit Subquery(const Model_T& obj, std::string column = "")
+  :table_name(obj.table_name), column(column.empty() ? obj.table_name + "_id" : std::move(column)) {}
+
+  Subquery& where(const Q& expr);
+
+  //Raw column comparison against the outer query, e.g. "message.sender = users.users_id".
+  Subquery& correlate(std::string condition){
+    correlations.push_back(std::move(condition));
+    return *this;
+  }
+
+  std::string sql(pqxx::params& params, pqxx::placeholders& ph) const;
+
+private:
+  std::string table_name, column;
+  std::vector<std::string> correlations;
+  std::shared_ptr<const Q> expr;
+};
+
+//Filter expression tree: leaves are single conditions, and &, | and ! nest them arbitrarily.
+//The same tree renders to parameterized SQL or is evaluated against loaded records.
+class Q{
+public:
+  Q(std::string column, OP op, Utils::Value_T value)
+  :kind(LEAF), condition(std::make_shared<const Utils::Condition>(std::move(column), op, std::move(value))) {}
+  Q(const Utils::Condition& condition)
+  :kind(LEAF), condition(std::make_shared<const Utils::Condition>(condition)) {}
+
+  static Q in(std::string column, Subquery subquery){
+    Q node {IN};
+    node.column = std::move(column);
+    node.subquery = std::make_shared<const Subquery>(std::move(subquery));
+    return node;
+  }
+
+  static Q exists(Subquery subquery){
+    Q node {EXISTS};
+    node.subquery = std::make_shared<const Subquery>(std::move(subquery));
+    return node;
+  }
+
+  //Matches every row. update() and remove() refuse an empty filter list, so touching a whole table is spelled out.
+  static Q all(){ return Q{ALL}; }
+
+  friend Q operator&(Q lhs, Q rhs){ return combine(AND, std::move(lhs), std::move(rhs)); }
+  friend Q operator|(Q lhs, Q rhs){ return combine(OR, std::move(lhs), std::move(rhs)); }
+  friend Q operator!(Q q){
+    if(q.kind == NOT) return std::move(q.children.front());
+    Q node {NOT};
+    node.children.push_back(std::move(q));
+    return node;
+  }
+
+  std::string sql(pqxx::params& params, pqxx::placeholders& ph) const {
+    switch(kind){
+      case LEAF: return condition_sql(*condition, params, ph);
+      case IN: return column + " in (" + subquery->sql(params, ph) + ")";
+      case EXISTS: return "exists (" + subquery->sql(params, ph) + ")";
+      case ALL: return "true";
+      case NOT: return "not (" + children.front().sql(params, ph) + ")";
+      default:{
+        std::string expr_str {};
+        for(const Q& child : children){
+          if(!expr_str.empty()) expr_str += kind == AND ? " and " : " or ";
+          expr_str += child.sql(params, ph);
+        }
+        return "(" + expr_str + ")";
+      }
+    }
+  }
+
+  bool matches(const pqxx::row& row) const {
+    switch(kind){
+      case LEAF: return condition_matches(row.at(condition->column), *condition);
+      case IN:
+      case EXISTS:
+        throw std::runtime_error("[ERROR: 'Q.matches()'] => Subquery conditions can only be evaluated by the database.");
+      case ALL: return true;
+      case NOT: return !children.front().matches(row);
+      case AND: return std::all_of(children.begin(), children.end(), [&](const Q& child){ return child.matches(row); });
+      default: return std::any_of(children.begin(), children.end(), [&](const Q& child){ return child.matches(row); });
+    }
+  }
+
+private:
+  enum Kind{LEAF=1, IN, EXISTS, ALL, AND, OR, NOT};
+
+  explicit Q(Kind kind): kind(kind) {}
+
+  //Chains of the same operator are flattened so a & b & c renders as one group.
+  static Q combine(Kind kind, Q lhs, Q rhs){
+    Q node {kind};
+    for(Q* side : {&lhs, &rhs}){
+      if(side->kind == kind) std::move(side->children.begin(), side->children.end(), std::back_inserter(node.children));
+      else node.children.push_back(std::move(*side));
+    }
+    return node;
+  }
+
+  Kind kind;
+  std::shared_ptr<const Utils::Condition> condition;
+  std::string column;
+  std::shared_ptr<const Subquery> subquery;
+  std::vector<Q> children;
+};
+
+inline Subquery& Subquery::where(const Q& expr){
+  this->expr = std::make_shared<const Q>(this->expr ? *this->expr & expr : expr);
+  return *this;
+}
+
+//Renders into the outer statement's params, so placeholders keep counting across both queries.
+inline std::string Subquery::sql(pqxx::params& params, pqxx::placeholders& ph) const {
+  std::string where_str = Utils::join(correlations, " and ");
+  if(expr) where_str += (where_str.empty() ? "" : " and ") + expr->sql(params, ph);
+  return "select " + column + " from " + table_name + (where_str.empty() ? "" : " where " + where_str);
+}
+
+template <typename Model_T>
+void filter(Model_T& obj, const Q& expr){
+  if(obj.records.empty()){
+    pqxx::params params {};
+    pqxx::placeholders ph {};
+    dbfetch(obj, select_statement(obj) + " where " + expr.sql(params, ph), params);
+    return;
+  }
+
+  std::vector<pqxx::row> filtered_rows {};
+  for(const pqxx::row& row : obj.records){
+    if(expr.matches(row)) filtered_rows.push_back(row);
+  }
+  obj.records = std::move(filtered_rows);
+}
+
+template <typename Model_T>
+void filter(Model_T& obj, std::string logical_op, Utils::filters& filters){
+  if(obj.records.empty()){
+    std::string sql_str = "select * from " + obj.table_name + " where " + build_filter_args(logical_op, filters) + ";";
+    std::cout<<sql_str<<std::endl;
+    dbfetch(obj, sql_str);
+  }else{
+    std::vector<pqxx::row> filtered_rows {};
+    if (logical_op == "and"){
+      for(const pqxx::row& row : obj.records){
+        bool accept_row = true;
+        for(Utils::Condition& filter: filters){
+          if(!matches_conditions(row.at(filter.column), filter.op, filter.value)){
+            accept_row = false;
+            break;
+          }
+        }
+        if(accept_row){
+          filtered_rows.push_back(row);
+          continue;
         }
       }
     }else if(logical_op == "or"){
@@ -488,51 +1416,543 @@ void filter(Model_T& obj, std::string logical_op, Utils::filters& filters){
   }
 }
 
+template <typename Model_T>
+std::size_t update(Model_T& obj, std::string logical_op, Utils::filters& filters, Utils::assignments& set){
+  if(set.empty()) throw std::runtime_error("[ERROR: in 'update()'] => No columns to update.");
+  if(filters.empty()) throw std::runtime_error("[ERROR: in 'update()'] => No filters given; pass Q::all() to update every row.");
+  pqxx::params params {};
+  pqxx::placeholders ph {};
+  std::string sql_str = "update " + obj.table_name + " set ";
+
+  for(auto& [column, value] : set){
+    sql_str += column + " = " + ph.get() + ",";
+    ph.next();
+    std::visit([&](auto& v){ params.append(v); }, value);
+  }
+  sql_str.pop_back();
+  sql_str += " where " + build_filter_sql(logical_op, filters, params, ph);
+
+  return exec_write(sql_str, params, "update()");
+}
+
+template <typename Model_T>
+std::size_t update(Model_T& obj, const Q& expr, Utils::assignments& set){
+  if(set.empty()) throw std::runtime_error("[ERROR: in 'update()'] => No columns to update.");
+  pqxx::params params {};
+  pqxx::placeholders ph {};
+  std::string sql_str = "update " + obj.table_name + " set ";
+
+  for(auto& [column, value] : set){
+    sql_str += column + " = " + ph.get() + ",";
+    ph.next();
+    std::visit([&](auto& v){ params.append(v); }, value);
+  }
+  sql_str.pop_back();
+  sql_str += " where " + expr.sql(params, ph);
+
+  return exec_write(sql_str, params, "update()");
+}
+
+template <typename Model_T>
+std::size_t remove(Model_T& obj, const Q& expr){
+  pqxx::params params {};
+  pqxx::placeholders ph {};
+  std::string sql_str = "delete from " + obj.table_name + " where " + expr.sql(params, ph);
+
+  return exec_write(sql_str, params, "remove()");
+}
+
+template <typename Model_T>
+std::size_t remove(Model_T& obj, std::string logical_op, Utils::filters& filters){
+  if(filters.empty()) throw std::runtime_error("[ERROR: in 'remove()'] => No filters given; pass Q::all() to delete every row.");
+  pqxx::params params {};
+  pqxx::placeholders ph {};
+  std::string sql_str = "delete from " + obj.table_name + " where " + build_filter_sql(logical_op, filters, params, ph);
+
+  return exec_write(sql_str, params, "remove()");
+}
+
+//casts, when given, holds one SQL type per value and is applied to the row, typing the whole VALUES list.
+template <typename tuple_T, std::size_t... I>
+std::string values_row(pqxx::placeholders& ph, const std::vector<std::string>& casts, std::index_sequence<I...>){
+  std::string row = "(";
+  ([&]{
+    row += ph.get();
+    if(!casts.empty()) row += "::" + casts[I];
+    row += ",";
+    ph.next();
+  }(), ...);
+  row.back() = ')';
+  return row;
+}
+
+//Writes every column of each instance back to its row, matched on id, with one
+//UPDATE ... FROM (VALUES ...) statement per batch.
+template <typename Model_T>
+std::size_t bulk_update(const std::vector<Model_T>& rows){
+  static_assert(typed_columns<Model_T>, "bulk_update() needs the sql_types member emitted by create_models_hpp(); regenerate models.hpp.");
+  using tuple_T = decltype(std::declval<Model_T>().get_attr());
+  constexpr auto indices = std::make_index_sequence<std::tuple_size_v<tuple_T>>{};
+  if(rows.empty()) return 0;
+
+  const Model_T& first = rows.front();
+  std::string id_col = first.table_name + "_id";
+  std::string set_str {}, col_str = first.col_str + ",";
+  for(std::string::size_type pos = 0, comma; (comma = col_str.find(',', pos)) != std::string::npos; pos = comma + 1){
+    std::string col = col_str.substr(pos, comma - pos);
+    set_str += col + " = v." + col + ",";
+  }
+  set_str.pop_back();
+
+  //Parameters arrive untyped, so the first row casts each value to its column's type; text would not assign to e.g. timestamp.
+  std::vector<std::string> casts {"integer"}, no_casts {};
+  casts.insert(casts.end(), Model_T::sql_types.begin(), Model_T::sql_types.end());
+
+  std::size_t affected = 0;
+  for(std::size_t begin = 0; begin < rows.size(); begin += bulk_batch_size){
+    std::size_t end = std::min(rows.size(), begin + bulk_batch_size);
+    pqxx::params params {};
+    pqxx::placeholders ph {};
+    std::string values_str {};
+
+    for(std::size_t i = begin; i < end; ++i){
+      values_str += values_row<tuple_T>(ph, i == begin ? casts : no_casts, indices) + ",";
+      std::apply([&](const auto&... cols){ (params.append(cols), ...); }, rows[i].get_attr());
+    }
+    values_str.pop_back();
+
+    std::string sql_str = "update " + first.table_name + " as t set " + set_str + " from (values " + values_str +
+                          ") as v(" + id_col + "," + first.col_str + ") where t." + id_col + " = v." + id_col;
+    affected += exec_write(sql_str, params, "bulk_update()");
+  }
+  return affected;
+}
+
+constexpr std::size_t copy_threshold = 10000;
+
+//With no conflict columns the model's unique key is the target, as long as it has exactly one;
+//with several the choice would be arbitrary, so the caller has to name the columns.
+template <typename Model_T>
+std::vector<std::string> conflict_target(const Model_T& obj, const std::vector<std::string>& conflict_columns){
+  if(!conflict_columns.empty()) return conflict_columns;
+
+  std::size_t key_count = 0;
+  std::string key {};
+  if constexpr(keyed_columns<Model_T>){
+    key_count = Model_T::unique_keys.size();
+    if(key_count == 1) key = std::string(Model_T::unique_keys[0]);
+  }
+  if(key_count == 0)
+    throw std::runtime_error(std::format("[ERROR: in 'upsert()'] => Model '{}' has no unique columns, pass the conflict columns.", obj.table_name));
+  if(key_count > 1)
+    throw std::runtime_error(std::format("[ERROR: in 'upsert()'] => Model '{}' has {} unique keys, pass the conflict columns.",
+                                         obj.table_name, key_count));
+
+  std::vector<std::string> target {};
+  std::string keys = key + ",";
+  for(std::string::size_type pos = 0, comma; (comma = keys.find(',', pos)) != std::string::npos; pos = comma + 1){
+    target.push_back(keys.substr(pos, comma - pos));
+  }
+  return target;
+}
+
+//With no update columns conflicting rows are left untouched.
+inline std::string conflict_clause(const std::vector<std::string>& conflict_columns, const std::vector<std::string>& update_columns){
+  std::string clause = " on conflict (" + Utils::join(conflict_columns) + ")";
+  if(update_columns.empty()) return clause + " do nothing";
+
+  clause += " do update set ";
+  for(const std::string& col : update_columns) clause += col + " = excluded." + col + ",";
+  clause.pop_back();
+  return clause;
+}
+
+template <typename tuple_T, std::size_t... I>
+std::string conflict_key(const tuple_T& attrs, const std::vector<std::size_t>& positions, std::index_sequence<I...>){
+  std::string key {};
+  bool has_null = false;
+  auto append = [&](std::size_t pos, const auto& v){
+    if(std::find(positions.begin(), positions.end(), pos) == positions.end()) return;
+    if(pqxx::is_null(v)) has_null = true;
+    else key += pqxx::to_string(v) + '\x1f';
+  };
+  (append(I, std::get<I>(attrs)), ...);
+  return has_null ? std::string{} : key;
+}
+
+//ON CONFLICT DO UPDATE can't touch the same row twice in one statement, so rows repeating a conflict key
+//are collapsed, the last one winning. Rows with a NULL key never conflict and are all kept.
+template <typename Model_T>
+std::vector<const Model_T*> last_per_key(const std::vector<Model_T>& rows, const std::vector<std::string>& conflict_columns){
+  using tuple_T = decltype(std::declval<Model_T>().get_attr());
+  constexpr auto indices = std::make_index_sequence<std::tuple_size_v<tuple_T>>{};
+  const Model_T& first = rows.front();
+
+  std::vector<std::string> names {first.table_name + "_id"};
+  std::string col_str = first.col_str + ",";
+  for(std::string::size_type pos = 0, comma; (comma = col_str.find(',', pos)) != std::string::npos; pos = comma + 1){
+    names.push_back(col_str.substr(pos, comma - pos));
+  }
+  std::vector<std::size_t> positions {};
+  for(const std::string& col : conflict_columns){
+    auto it = std::find(names.begin(), names.end(), col);
+    if(it == names.end())
+      throw std::runtime_error(std::format("[ERROR: in 'upsert()'] => '{}' is not a column of '{}'.", col, first.table_name));
+    positions.push_back(static_cast<std::size_t>(it - names.begin()));
+  }
+
+  std::vector<const Model_T*> unique_rows {};
+  std::unordered_map<std::string, std::size_t> seen {};
+  unique_rows.reserve(rows.size());
+  for(const Model_T& row : rows){
+    std::string key = conflict_key(row.get_attr(), positions, indices);
+    if(key.empty()){
+      unique_rows.push_back(&row);
+      continue;
+    }
+    auto [it, inserted] = seen.try_emplace(std::move(key), unique_rows.size());
+    if(inserted) unique_rows.push_back(&row);
+    else unique_rows[it->second] = &row;
+  }
+  return unique_rows;
+}
+
+//Loads the rows into a temporary table through COPY and merges them with one statement.
+template <typename Model_T>
+std::size_t upsert_copy(const std::vector<const Model_T*>& rows, const std::string& on_conflict){
+  const Model_T& first = *rows.front();
+  std::string tmp_table = "strata_upsert_" + first.table_name;
+  Pool::Lease lease = Pool::instance().acquire(PRIMARY);
+  try{
+    pqxx::work txn(lease.cxn());
+    std::size_t affected = 0;
+    {
+      Deadline deadline {lease.cxn(), txn};
+      txn.exec("create temp table " + tmp_table + " on commit drop as select " + first.col_str +
+               " from " + first.table_name + " with no data");
+
+      pqxx::stream_to stream = pqxx::stream_to::raw_table(txn, tmp_table, first.col_str);
+      for(const Model_T* row : rows) stream.write_tuple(Utils::tail(row->get_attr()));
+      stream.complete();
+
+      affected = txn.exec("insert into " + first.table_name + " (" + first.col_str + ") select " + first.col_str +
+                          " from " + tmp_table + on_conflict).affected_rows();
+    }
+    txn.commit();
+    Session::current().record_write(lease.cxn());
+    return affected;
+  }catch(const pqxx::query_canceled& e){
+    throw timeout_error(std::format("[ERROR: in 'upsert()'] => {}", e.what()));
+  }catch(const std::exception& e){
+    throw std::runtime_error(std::format("[ERROR: in 'upsert()'] => {}", e.what()));
+  }
+}
+
+template <typename Model_T>
+std::size_t upsert(const std::vector<Model_T>& rows, const std::vector<std::string>& conflict_columns = {},
+                   const std::vector<std::string>& update_columns = {}){
+  using tail_T = decltype(Utils::tail(std::declval<Model_T>().get_attr()));
+  constexpr auto indices = std::make_index_sequence<std::tuple_size_v<tail_T>>{};
+  if(rows.empty()) return 0;
+
+  const Model_T& first = rows.front();
+  std::vector<std::string> target = conflict_target(first, conflict_columns);
+  std::string on_conflict = conflict_clause(target, update_columns);
+  std::vector<const Model_T*> unique_rows = last_per_key(rows, target);
+  if(unique_rows.size() >= copy_threshold) return upsert_copy(unique_rows, on_conflict);
+
+  std::size_t affected = 0;
+  for(std::size_t begin = 0; begin < unique_rows.size(); begin += bulk_batch_size){
+    std::size_t end = std::min(unique_rows.size(), begin + bulk_batch_size);
+    pqxx::params params {};
+    pqxx::placeholders ph {};
+    std::string values_str {};
+
+    for(std::size_t i = begin; i < end; ++i){
+      values_str += values_row<tail_T>(ph, {}, indices) + ",";
+      params.append(row_params(*unique_rows[i]));
+    }
+    values_str.pop_back();
+
+    std::string sql_str = "insert into " + first.table_name + " (" + first.col_str + ") values " + values_str + on_conflict;
+    affected += exec_write(sql_str, params, "upsert()");
+  }
+  return affected;
+}
+
+//Without with_defaults only the generated id is written back, with it the whole row is
+//re-read so server defaults (eg DateTimeField DEFAULT NOW()) land in the instance too.
+template <typename Model_T>
+std::string returning_clause(const Model_T& obj, bool with_defaults){
+  return " returning " + (with_defaults ? select_columns(obj) : obj.table_name + "_id");
+}
+
+template <typename Model_T>
+void write_back(Model_T& instance, const pqxx::row& row, bool with_defaults){
+  if(with_defaults) instance = Model_T(row.template as_tuple<decltype(instance.get_attr())>());
+  else instance.id = row[0].template as<decltype(instance.id)>();
+}
+
+template <typename Model_T>
+void insert(Model_T& instance, bool with_defaults = false){
+  std::string sql_str = insert_sql(instance);
+  sql_str.pop_back();
+  pqxx::params params = row_params(instance);
+
+  pqxx::result result = exec_write_result(sql_str + returning_clause(instance, with_defaults), params, "insert()");
+  write_back(instance, result.one_row(), with_defaults);
+}
+
+//Hands out ids reserved from the model's <model>_id sequence, one nextval() round trip per
+//block, so object graphs can be linked client-side before anything is inserted.
+template <typename Model_T>
+class IdAllocator{
+  using id_T = decltype(std::declval<Model_T>().id);
+
+  std::string sequence_sql;
+  std::size_t block_size;
+  std::vector<id_T> block {};
+  std::size_t cursor = 0;
+
+  void reserve(std::size_t n){
+    Pool::Lease lease = Pool::instance().acquire(PRIMARY);
+    try{
+      pqxx::nontransaction txn(lease.cxn());
+      block.clear();
+      cursor = 0;
+      for(const pqxx::row& row : txn.exec(pqxx::prepped{lease.prepare(sequence_sql)}, pqxx::params{static_cast<long long>(n)})){
+        block.push_back(row[0].template as<id_T>());
+      }
+    }catch(const std::exception& e){
+      throw std::runtime_error(std::format("[ERROR: in 'IdAllocator.reserve()'] => {}", e.what()));
+    }
+  }
+
+public:
+  explicit IdAllocator(std::size_t block_size = 1000): block_size(block_size){
+    Model_T obj {};
+    sequence_sql = "select nextval(pg_get_serial_sequence('" + obj.table_name + "', '" + obj.table_name +
+                   "_id')) from generate_series(1, $1)";
+  }
+
+  id_T next(){
+    if(cursor == block.size()) reserve(block_size);
+    return block[cursor++];
+  }
+
+  void assign(std::vector<Model_T>& rows){
+    std::size_t available = block.size() - cursor;
+    if(available < rows.size()){
+      std::vector<id_T> leftover(block.begin() + cursor, block.end());
+      reserve(rows.size() - available);
+      block.insert(block.begin(), leftover.begin(), leftover.end());
+    }
+    for(Model_T& row : rows) row.id = block[cursor++];
+  }
+};
+
+//Ids are reserved up front and sent with the rows, so each instance keeps its own id however the server orders
+//the RETURNING rows; with_defaults re-reads the rows and matches them back on that id.
+template <typename Model_T>
+void bulk_insert(std::vector<Model_T>& rows, bool with_defaults = false){
+  using tuple_T = decltype(std::declval<Model_T>().get_attr());
+  using id_T = decltype(std::declval<Model_T>().id);
+  constexpr auto indices = std::make_index_sequence<std::tuple_size_v<tuple_T>>{};
+  if(rows.empty()) return;
+
+  const Model_T& first = rows.front();
+  IdAllocator<Model_T> allocator(rows.size());
+  std::vector<id_T> ids(rows.size());
+  for(id_T& id : ids) id = allocator.next();
+
+  std::string returning = with_defaults ? returning_clause(first, true) : "";
+  for(std::size_t begin = 0; begin < rows.size(); begin += bulk_batch_size){
+    std::size_t end = std::min(rows.size(), begin + bulk_batch_size);
+    pqxx::params params {};
+    pqxx::placeholders ph {};
+    std::string values_str {};
+
+    for(std::size_t i = begin; i < end; ++i){
+      values_str += values_row<tuple_T>(ph, {}, indices) + ",";
+      params.append(ids[i]);
+      params.append(row_params(rows[i]));
+    }
+    values_str.pop_back();
+
+    std::string sql_str = "insert into " + first.table_name + " (" + select_columns(first) + ") values " + values_str + returning;
+    if(!with_defaults){
+      exec_write(sql_str, params, "bulk_insert()");
+      for(std::size_t i = begin; i < end; ++i) rows[i].id = ids[i];
+      continue;
+    }
+
+    pqxx::result result = exec_write_result(sql_str, params, "bulk_insert()");
+    std::unordered_map<id_T, std::size_t> by_id {};
+    for(std::size_t i = begin; i < end; ++i) by_id.emplace(ids[i], i);
+    for(const pqxx::row& row : result){
+      auto it = by_id.find(row[0].template as<id_T>());
+      if(it == by_id.end())
+        throw std::runtime_error("[ERROR: in 'bulk_insert()'] => Returned a row that was not inserted.");
+      write_back(rows[it->second], row, true);
+    }
+  }
+}
+
+//COPY-loads rows whose ids are already set (eg from an IdAllocator), split over
+//thread_count connections. Each chunk commits on its own.
+template <typename Model_T>
+void copy_insert(const std::vector<Model_T>& rows, unsigned thread_count = 0){
+  if(rows.empty()) return;
+  const Model_T& first = rows.front();
+  std::string columns = select_columns(first);
+
+  try{
+    Utils::parallel_chunks(rows.size(), thread_count, [&](std::size_t begin, std::size_t end){
+      Pool::Lease lease = Pool::instance().acquire(PRIMARY);
+      pqxx::work txn(lease.cxn());
+      pqxx::stream_to stream = pqxx::stream_to::raw_table(txn, first.table_name, columns);
+      for(std::size_t i = begin; i < end; ++i) stream.write_tuple(rows[i].get_attr());
+      stream.complete();
+      txn.commit();
+    }, bulk_batch_size);
+  }catch(const std::exception& e){
+    throw std::runtime_error(std::format("[ERROR: in 'copy_insert()'] => {}", e.what()));
+  }
+
+  Pool::Lease lease = Pool::instance().acquire(PRIMARY);
+  Session::current().record_write(lease.cxn());
+}
+
+template <typename Model_T>
+std::string qualified_columns(const Model_T& obj){
+  std::string columns = obj.table_name + "." + obj.table_name + "_id";
+  std::string col_str = obj.col_str + ",";
+  for(std::string::size_type pos = 0, comma; (comma = col_str.find(',', pos)) != std::string::npos; pos = comma + 1){
+    columns += "," + obj.table_name + "." + col_str.substr(pos, comma - pos);
+  }
+  return columns;
+}
+
+//In a typed join, std::optional<Model> marks the side an outer join may leave unmatched.
+template <typename T>
+struct join_side{
+  using model = T;
+  using attrs = decltype(std::declval<T>().get_attr());
+  using values = attrs;
+  static constexpr bool optional = false;
+};
+
+template <typename T>
+struct join_side<std::optional<T>>{
+  using model = T;
+  using attrs = decltype(std::declval<T>().get_attr());
+  using values = std::optional<attrs>;
+  static constexpr bool optional = true;
+};
+
+//An unmatched side comes back with a NULL id: nullopt for an optional side, an error otherwise.
+template <typename Side_T>
+bool side_matched(const pqxx::row& row, std::size_t offset){
+  if(!row[static_cast<pqxx::row::size_type>(offset)].is_null()) return true;
+  if constexpr(!join_side<Side_T>::optional)
+    throw std::runtime_error(std::format("[ERROR: 'JoinBuilder.execute()'] => '{}' is unmatched in an outer join row; "
+                                         "request it as std::optional<{}>.", typename join_side<Side_T>::model{}.table_name,
+                                         typename join_side<Side_T>::model{}.table_name));
+  return false;
+}
+
+template <typename Side_T>
+Side_T decode_model(const pqxx::row& row, std::size_t& offset){
+  using tuple_T = typename join_side<Side_T>::attrs;
+  std::size_t begin = offset;
+  offset += std::tuple_size_v<tuple_T>;
+  if(!side_matched<Side_T>(row, begin)) return Side_T{};
+  return Side_T(typename join_side<Side_T>::model(decode_row<tuple_T>(row, begin)));
+}
+
+template <typename Side_T>
+typename join_side<Side_T>::values decode_attrs(const pqxx::row& row, std::size_t& offset){
+  using tuple_T = typename join_side<Side_T>::attrs;
+  std::size_t begin = offset;
+  offset += std::tuple_size_v<tuple_T>;
+  if(!side_matched<Side_T>(row, begin)) return {};
+  return decode_row<tuple_T>(row, begin);
+}
+
 class JoinBuilder{
-  std::string query_str, table_name;
+  std::string select_str, join_str, where_str, table_name;
   bool join_pending = true;
+  pqxx::params params {};
+  pqxx::placeholders ph {};
+
+  //Every call with the same shape reuses one prepared statement per pooled connection.
+  pqxx::result run(const std::string& sql_string){
+    Pool::Lease lease = Pool::instance().acquire(REPLICA);
+    auto start = std::chrono::steady_clock::now();
+    try{
+      pqxx::work txn {lease.cxn()};
+      pqxx::result join_results {};
+      {
+        Deadline deadline {lease.cxn(), txn};
+        join_results = txn.exec(pqxx::prepped{lease.prepare(sql_string)}, params);
+      }
+      txn.commit();
+      Router::instance().observe(lease.cxn(), std::chrono::steady_clock::now() - start, true);
+      return join_results;
+    }catch(const pqxx::query_canceled& e){
+      throw timeout_error(std::format("[ERROR: 'JoinBuilder.execute()'] => {}", e.what()));
+    }catch(const pqxx::broken_connection& e){
+      Router::instance().observe(lease.cxn(), std::chrono::steady_clock::now() - start, false);
+      throw std::runtime_error(std::format("[ERROR: 'JoinBuilder.execute()'] => {}", e.what()));
+    }catch(const std::exception& e){
+      throw std::runtime_error(std::format("[ERROR: 'JoinBuilder.execute()'] => {}", e.what()));
+    }
+  }
+
+  std::string from_str() const {
+    return " from " + table_name + join_str + (where_str.empty() ? "" : " where " + where_str);
+  }
 public:
   template<typename T>
   JoinBuilder(T& model): table_name(model.table_name) {}
 
   template<all_same_as_t<std::string>... Args>
   JoinBuilder& select(Args&&... columns){
-    query_str = "select " + ((to_str(columns) + ",") + ...);
-    query_str.pop_back();
-    query_str += " from " + table_name;
+    select_str = ((Utils::to_str(columns) + ",") + ...);
+    select_str.pop_back();
     return *this;
   }
 
   JoinBuilder& inner_join(std::string join_table){
-    query_str += " inner join " + join_table;
+    join_str += " inner join " + join_table;
     if(!join_pending)
       throw std::runtime_error("[ERROR: 'JoinBuilder.inner_join()'] => You have not implemented on() yet for the previous join!");
     join_pending = false;
     return *this;
   }
   JoinBuilder& outer_join(std::string join_table){
-    query_str += " outer join " + join_table;
+    join_str += " outer join " + join_table;
     if(!join_pending)
       throw std::runtime_error("[ERROR: 'JoinBuilder.inner_join()'] => You have not implemented on() yet for the previous join!");
     join_pending = false;
     return *this;
   }
   JoinBuilder& full_join(std::string join_table){
-    query_str += " full join " + join_table;
+    join_str += " full join " + join_table;
     if(!join_pending)
       throw std::runtime_error("[ERROR: 'JoinBuilder.inner_join()'] => You have not implemented on() yet for the previous join!");
     join_pending = false;
     return *this;
   }
   JoinBuilder& left_join(std::string join_table){
-    query_str += " left join " + join_table;
+    join_str += " left join " + join_table;
     if(!join_pending)
       throw std::runtime_error("[ERROR: 'JoinBuilder.inner_join()'] => You have not implemented on() yet for the previous join!");
     join_pending = false;
     return *this;
   }
   JoinBuilder& right_join(std::string join_table){
-    query_str += " right join " + join_table;
+    join_str += " right join " + join_table;
     if(!join_pending)
       throw std::runtime_error("[ERROR: 'JoinBuilder.inner_join()'] => You have not implemented on() yet for the previous join!");
     join_pending = false;
@@ -545,26 +1965,74 @@ public:
       throw std::runtime_error("[ERROR: 'JoinBuilder.on()'] => Join pending");
     if(logical_op != "and" && logical_op != "or")
       throw std::runtime_error(std::format("[ERROR: 'JoinBuilder.on()] => Unknown logical operator: {}", logical_op));
-    query_str += " on " + ((to_str(conditions) + " " + logical_op + " ") + ...);
-    query_str.resize(query_str.size() - (logical_op.size() + 2));
+    join_str += " on " + ((Utils::to_str(conditions) + " " + logical_op + " ") + ...);
+    join_str.resize(join_str.size() - (logical_op.size() + 2));
     join_pending = true;
     return *this;
   }
 
+  //Join condition comparing columns against bound values instead of pasted literals.
+  JoinBuilder& on(std::string logical_op, Utils::filters& conditions){
+    if(join_pending)
+      throw std::runtime_error("[ERROR: 'JoinBuilder.on()'] => Join pending");
+    join_str += " on " + build_filter_sql(logical_op, conditions, params, ph);
+    join_pending = true;
+    return *this;
+  }
+
+  JoinBuilder& where(std::string logical_op, Utils::filters& filters){
+    if(!join_pending)
+      throw std::runtime_error("[ERROR: 'JoinBuilder.where()'] => Join pending");
+    std::string filter_str = "(" + build_filter_sql(logical_op, filters, params, ph) + ")";
+    where_str += (where_str.empty() ? "" : " and ") + filter_str;
+    return *this;
+  }
+
+  //Identifies the statement independently of its bound values.
+  std::uint64_t shape_key(){
+    return Utils::fnv1a(str());
+  }
+
   pqxx::result execute(){
-    pqxx::connection cxn = connect();
-    try{
-      pqxx::work txn {cxn};
-      pqxx::result join_results = txn.exec(query_str + ";");
-      txn.commit();
-      return join_results;
-    }catch(const std::exception& e){
-      throw std::runtime_error(std::format("[ERROR: 'JoinBuilder.execute()'] => {}", e.what()));
+    return run(str());
+  }
+
+  //Selects every column of each model in get_attr() order and decodes each joined row
+  //into one instance per model. Sides an outer join may leave unmatched are requested as std::optional<Model>.
+  template <typename... Model_Ts>
+  requires (sizeof...(Model_Ts) > 0)
+  std::vector<std::tuple<Model_Ts...>> execute(){
+    std::string columns = ((qualified_columns(typename join_side<Model_Ts>::model{}) + ",") + ...);
+    columns.pop_back();
+    pqxx::result result = run("select " + columns + from_str() + ";");
+
+    std::vector<std::tuple<Model_Ts...>> rows {};
+    rows.reserve(result.size());
+    for(const pqxx::row& row : result){
+      std::size_t offset = 0;
+      rows.push_back(std::tuple<Model_Ts...>{decode_model<Model_Ts>(row, offset)...});
+    }
+    return rows;
+  }
+
+  template <typename... Model_Ts>
+  requires (sizeof...(Model_Ts) > 0)
+  std::vector<std::tuple<typename join_side<Model_Ts>::values...>> execute_values(){
+    std::string columns = ((qualified_columns(typename join_side<Model_Ts>::model{}) + ",") + ...);
+    columns.pop_back();
+    pqxx::result result = run("select " + columns + from_str() + ";");
+
+    std::vector<std::tuple<typename join_side<Model_Ts>::values...>> rows {};
+    rows.reserve(result.size());
+    for(const pqxx::row& row : result){
+      std::size_t offset = 0;
+      rows.push_back(std::tuple<typename join_side<Model_Ts>::values...>{decode_attrs<Model_Ts>(row, offset)...});
     }
+    return rows;
   }
 
   std::string str(){
-    return query_str + ";";
+    return "select " + (select_str.empty() ? std::string("*") : select_str) + from_str() + ";";
   }
 };
 
@@ -592,10 +2060,223 @@ std::vector<decltype(std::declval<Model_T>().get_attr())> to_values(Model_T& obj
 
   return values;
 }
+
+template <typename Model_T>
+std::vector<Model_T> to_instances(Model_T& obj, unsigned thread_count){
+  using tuple_T = decltype(obj.get_attr());
+  std::vector<Model_T> instances(obj.records.size());
+
+  Utils::parallel_chunks(obj.records.size(), thread_count, [&](std::size_t begin, std::size_t end){
+    for(std::size_t i = begin; i < end; ++i){
+      instances[i] = Model_T(obj.records[i].template as_tuple<tuple_T>());
+    }
+  });
+  return instances;
+}
+
+template <typename Model_T>
+std::vector<decltype(std::declval<Model_T>().get_attr())> to_values(Model_T& obj, unsigned thread_count){
+  using tuple_T = decltype(obj.get_attr());
+  std::vector<tuple_T> values(obj.records.size());
+
+  Utils::parallel_chunks(obj.records.size(), thread_count, [&](std::size_t begin, std::size_t end){
+    for(std::size_t i = begin; i < end; ++i){
+      values[i] = obj.records[i].template as_tuple<tuple_T>();
+    }
+  });
+  return values;
+}
+
+//The string_views point into obj.records and are only valid while those rows are alive.
+template <typename Model_T>
+std::vector<Utils::view_of_t<decltype(std::declval<Model_T>().get_attr())>> to_values_view(Model_T& obj){
+  using view_T = Utils::view_of_t<decltype(obj.get_attr())>;
+  std::vector<view_T> values {};
+  values.reserve(obj.records.size());
+
+  for(const pqxx::row& row : obj.records){
+    values.push_back(decode_row<view_T>(row));
+  }
+
+  return values;
+}
+
+template <typename Model_T>
+ArenaValues<Utils::view_of_t<decltype(std::declval<Model_T>().get_attr())>> to_values_arena(Model_T& obj){
+  using view_T = Utils::view_of_t<decltype(obj.get_attr())>;
+  constexpr auto indices = std::make_index_sequence<std::tuple_size_v<view_T>>{};
+  ArenaValues<view_T> packed {};
+  packed.values = to_values_view(obj);
+
+  std::size_t arena_size = 0;
+  for(const view_T& tup : packed.values) arena_size += string_bytes(tup, indices);
+
+  packed.arena = std::make_unique_for_overwrite<char[]>(arena_size);
+  char* cursor = packed.arena.get();
+  for(view_T& tup : packed.values) pack_strings(tup, cursor, indices);
+
+  return packed;
+}
+}
+
+namespace shard{
+
+struct OrderBy{
+  std::string column;
+  bool descending = false;
+};
+
+std::size_t count();
+std::size_t shard_for(std::string_view key);
+pqxx::connection connect(std::size_t shard);
+std::vector<pqxx::row> merge(std::vector<pqxx::result>& results, const std::optional<OrderBy>& order, std::optional<std::size_t> limit);
+
+template <typename Model_T>
+std::size_t shard_of(const Model_T& instance){
+  return shard_for(pqxx::to_string(instance.shard_value()));
+}
+
+template <typename Model_T>
+void exec_insert(const Model_T& instance){
+  pqxx::connection cxn = connect(shard_of(instance));
+  try{
+    pqxx::work txn(cxn);
+    txn.exec(insert_sql(instance), row_params(instance)).no_rows();
+    txn.commit();
+  }catch(const std::exception& e){
+    throw std::runtime_error(std::format("[ERROR: in 'shard::exec_insert()'] => {}", e.what()));
+  }
+}
+
+template <typename Model_T>
+void bulk_insert(const std::vector<Model_T>& rows){
+  std::vector<std::vector<const Model_T*>> by_shard(count());
+  for(const Model_T& row : rows) by_shard[shard_of(row)].push_back(&row);
+
+  Utils::parallel_chunks(by_shard.size(), static_cast<unsigned>(by_shard.size()), [&](std::size_t begin, std::size_t end){
+    for(std::size_t shard = begin; shard < end; ++shard){
+      if(by_shard[shard].empty()) continue;
+      pqxx::connection cxn = connect(shard);
+      cxn.prepare("insert_stmt", insert_sql(*by_shard[shard].front()));
+      pqxx::work txn(cxn);
+      for(const Model_T* row : by_shard[shard]) txn.exec(pqxx::prepped{"insert_stmt"}, row_params(*row)).no_rows();
+      txn.commit();
+    }
+  }, 1);
+}
+
+//merge() compares text bytewise, so text sort columns are ordered COLLATE "C" on every shard to match it.
+//The column type comes from the generated sql_types; an unknown or non-text column is ordered as is.
+template <typename Model_T>
+std::string order_clause(const Model_T& obj, const OrderBy& order){
+  std::string clause = " order by " + order.column;
+  if constexpr(typed_columns<Model_T>){
+    std::size_t index = 0;
+    std::string col_str = obj.col_str + ",";
+    for(std::string::size_type pos = 0, comma; (comma = col_str.find(',', pos)) != std::string::npos; pos = comma + 1, ++index){
+      if(col_str.compare(pos, comma - pos, order.column) != 0 || index >= Model_T::sql_types.size()) continue;
+      std::string_view type = Model_T::sql_types[index];
+      if(type.starts_with("VARCHAR") || type.starts_with("CHAR") || type.starts_with("TEXT")) clause += " collate \"C\"";
+      break;
+    }
+  }
+  return clause + (order.descending ? " desc" : " asc");
+}
+
+//Runs the query on every shard in parallel and merges the rows into obj.records,
+//keeping the shards' ORDER BY and applying the LIMIT to the merged rows.
+template <typename Model_T>
+void scatter(Model_T& obj, const std::string& sql_string, const std::optional<OrderBy>& order, std::optional<std::size_t> limit,
+             const pqxx::params& params = {}){
+  std::string shard_sql = sql_string;
+  if(order) shard_sql += order_clause(obj, *order);
+  if(limit) shard_sql += " limit " + std::to_string(*limit);
+
+  std::vector<pqxx::result> results(count());
+  std::chrono::milliseconds timeout = Session::current().statement_timeout;
+  try{
+    Utils::parallel_chunks(results.size(), static_cast<unsigned>(results.size()), [&](std::size_t begin, std::size_t end){
+      for(std::size_t shard = begin; shard < end; ++shard){
+        pqxx::connection cxn = connect(shard);
+        pqxx::work txn(cxn);
+        Deadline deadline {cxn, txn, timeout};
+        results[shard] = txn.exec(shard_sql + ";", params);
+        txn.commit();
+      }
+    }, 1);
+  }catch(const pqxx::query_canceled& e){
+    throw timeout_error(std::format("[ERROR: in 'shard::scatter()'] => {}", e.what()));
+  }catch(const std::exception& e){
+    throw std::runtime_error(std::format("[ERROR: in 'shard::scatter()'] => {}", e.what()));
+  }
+
+  for(pqxx::row& row : merge(results, order, limit)) obj.records.push_back(row);
+}
+
+template <typename Model_T>
+void fetch_all(Model_T& obj, std::string columns, std::optional<OrderBy> order = std::nullopt, std::optional<std::size_t> limit = std::nullopt){
+  scatter(obj, "select " + columns + " from " + obj.table_name, order, limit);
+}
+
+template <typename Model_T>
+void filter(Model_T& obj, std::string logical_op, Utils::filters& filters,
+            std::optional<OrderBy> order = std::nullopt, std::optional<std::size_t> limit = std::nullopt){
+  pqxx::params params {};
+  pqxx::placeholders ph {};
+  std::string where_str = build_filter_sql(logical_op, filters, params, ph);
+  scatter(obj, "select * from " + obj.table_name + " where " + where_str, order, limit, params);
+}
 }
 
+enum Interval{DAY=1, WEEK, MONTH};
+
+//Name and bounds of the RANGE partition covering day, e.g. events_p20260101 for MONTH.
+std::string partition_name(const std::string& model_name, std::chrono::sys_days day, Interval interval);
+
+std::pair<std::chrono::sys_days, std::chrono::sys_days> partition_bounds(std::chrono::sys_days day, Interval interval);
+
+void create_range_partition(const std::string& model_name, std::chrono::sys_days day, Interval interval, std::ofstream& Migrations);
+
+//Creates the next premake RANGE partitions of a table and detaches and drops those that ended more than
+//retain intervals ago, so retention is a DROP TABLE instead of a DELETE. Meant to run on a schedule.
+//Returns the number of partitions dropped.
+std::size_t maintain_partitions(const std::string& model_name, Interval interval, int premake, int retain);
+
+//Tuning for the batched backfills run by execute_sql().
+inline std::size_t backfill_batch_size = 10000;
+inline std::chrono::milliseconds backfill_pause {100};
+
+//Sets NULLs in column to value_sql one id range per transaction, pausing between batches. Progress is kept in
+//strata_backfill_progress, so an interrupted backfill resumes after the last committed range. Returns rows updated.
+std::size_t backfill(const std::string& model_name, const std::string& column_name, const std::string& value_sql);
+
+std::vector<std::string> split_sql(const std::string& raw_sql);
+
+//How a statement of a migrations file is applied. CREATE/DROP INDEX CONCURRENTLY cannot run inside a transaction block.
+enum StepKind{TRANSACTIONAL=1, NON_TRANSACTIONAL, BACKFILL};
+
+struct MigrationStep{
+  StepKind kind;
+  std::string sql;
+  //Set for BACKFILL steps, parsed from the '-- strata:backfill' directive held in sql.
+  std::string table, column, value;
+};
+
+std::vector<MigrationStep> migration_steps(const std::string& raw_sql);
+
 std::optional<pqxx::result> execute_sql(std::string& sql_file_or_str, bool is_file_name = true);
 
+//Tuning for run_migrations(). A statement that can't take its locks within migration_lock_timeout is retried up to
+//migration_retries times, and the backoff doubles after each attempt.
+inline std::chrono::milliseconds migration_lock_timeout {5000};
+inline int migration_retries = 5;
+inline std::chrono::milliseconds migration_retry_backoff {500};
+
+//Applies a migrations file one statement, or one begin/commit group, per transaction. Each applied step is recorded in
+//strata_migrations with its duration.
+//Steps already recorded for the same file content are skipped, so a failed run can simply be repeated. Returns steps applied.
+std::size_t run_migrations(const std::string& sql_filename);
+
 }
 namespace db_adapter = psql;
 #else
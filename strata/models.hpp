@@ -2,6 +2,7 @@
 
 #include <string>
 #include <unordered_map>
+#include <vector>
 #include <functional>
 #include <memory>
 #include "./datatypes.hpp"
@@ -9,11 +10,49 @@
 using fields = std::unordered_map<std::string, DataTypeVariant>;
 using ms_map = std::unordered_map<std::string, fields>;
 
+//Secondary index declared on a model. Entries in columns may be plain columns or expressions
+//such as "lower(email)"; an empty name is derived from the table and columns.
+struct Index{
+  std::vector<std::string> columns;
+  std::string method = "btree";
+  std::string where;
+  bool unique = false;
+  std::string name;
+
+  bool operator==(const Index&) const = default;
+};
+
+//PARTITION BY settings. strategy is RANGE, LIST or HASH, or empty for a plain table;
+//modulus is the number of HASH partitions created with the table.
+struct Partition{
+  std::string strategy;
+  std::string column;
+  int modulus = 0;
+
+  bool operator==(const Partition&) const = default;
+};
+
+//expand_contract is a migration policy rather than schema and is not saved to schema.json.
+struct ModelMeta{
+  std::string shard_key;
+  std::vector<Index> indexes;
+  Partition partition;
+  bool expand_contract = false;
+};
+using meta_map = std::unordered_map<std::string, ModelMeta>;
+
 class Model{
 public:
   fields col_map;
+  std::string shard_key;
+  std::vector<Index> indexes;
+  Partition partition;
+  //Rewrite-free column type changes through a shadow column, trigger and batched backfill.
+  bool expand_contract = false;
   ms_map init_ms;
   ms_map new_ms;
+  meta_map init_meta;
+  meta_map new_meta;
 
   Model() = default;
 